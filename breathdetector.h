@@ -0,0 +1,205 @@
+#ifndef BREATHDETECTOR_H
+#define BREATHDETECTOR_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstddef>
+
+
+// the values of one breath, or the average over the last ones.
+struct BreathMetrics
+{
+    double time;      // end of the exhalation, in sec.
+    float etCO2;      // end-tidal (peak) CO2, in mmHg.
+    float inspCO2;    // lowest CO2 while breathing in, in mmHg.
+    float bpm;        // breaths per minute.
+};
+
+
+struct BreathDetectorConfig
+{
+    // averages are taken over the breaths that ended within this many sec.
+    double window = 30.0;
+    // hysteresis in mmHg: exhalation starts when the CO2 rises above
+    // riseThreshold, inhalation when it falls below fallThreshold.
+    float riseThreshold = 10.0f;
+    float fallThreshold = 5.0f;
+    // shorter phases (in sec.) are taken as noise, this also caps the rate
+    // at 60 / (2 * minPhase) BPM.
+    double minPhase = 0.2;
+};
+
+
+// Detects breaths in the raw CO2 waveform of one device and measures them.
+//
+// Works sample by sample in O(1) with a fixed amount of memory, so one core
+// keeps up with hundreds of channels. A breath is complete as soon as the
+// exhalation ends (the CO2 drops below fallThreshold), its values are
+// available with the latency of that one sample instead of waiting for the
+// averages the device sends every few breaths.
+class BreathDetector
+{
+public:
+    explicit BreathDetector(const BreathDetectorConfig &config = BreathDetectorConfig())
+        : config(config), breaths(maxBreaths)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        exhaling = false;
+        phaseStart = std::numeric_limits<double>::quiet_NaN();
+        exhaleStart = std::numeric_limits<double>::quiet_NaN();
+        previousExhaleStart = std::numeric_limits<double>::quiet_NaN();
+        phaseMin = std::numeric_limits<float>::infinity();
+        phaseMax = -std::numeric_limits<float>::infinity();
+        inspMin = std::numeric_limits<float>::quiet_NaN();
+        last = BreathMetrics{ 0, nan(), nan(), nan() };
+        first = 0;
+        count = 0;
+        etSum = inspSum = periodSum = 0;
+    }
+
+    // feeds one sample (time in sec., CO2 in mmHg). Returns true if it
+    // completed a breath, lastBreath() and average() have the new values then.
+    // A breath longer than the window (after a pause) is not averaged.
+    bool addSample(double time, float co2)
+    {
+        // corrupted samples (NaN, spikes) are skipped.
+        if (!(co2 > -5.0f && co2 < 150.0f))
+            return false;
+        if (std::isnan(phaseStart))
+            phaseStart = time;
+
+        if (co2 < phaseMin)
+            phaseMin = co2;
+        if (co2 > phaseMax)
+            phaseMax = co2;
+
+        const bool phaseLongEnough = time - phaseStart >= config.minPhase;
+        if (!exhaling)
+        {
+            if (co2 > config.riseThreshold && phaseLongEnough)
+            {
+                // inhalation over, remember its lowest value.
+                inspMin = phaseMin;
+                previousExhaleStart = exhaleStart;
+                exhaleStart = time;
+                startPhase(true, time, co2);
+            }
+            return false;
+        }
+
+        if (co2 >= config.fallThreshold || !phaseLongEnough)
+            return false;
+
+        // exhalation over: the breath ran from the previous exhalation start
+        // to this one, its peak was just measured.
+        const float peak = phaseMax;
+        startPhase(false, time, co2);
+        if (std::isnan(previousExhaleStart) || std::isnan(inspMin))
+            return false;
+
+        const double period = exhaleStart - previousExhaleStart;
+        if (period > config.window)
+        {
+            // the first breath after a pause (sensor off, apnea): its period
+            // is the whole gap, not a rate. The window starts over with the
+            // next breath, every older one has fallen out of it anyway.
+            last = BreathMetrics{ time, peak, inspMin, nan() };
+            while (count > 0)
+                popFront();
+            return false;
+        }
+        last = BreathMetrics{ time, peak, inspMin, static_cast<float>(60.0 / period) };
+        push(time, peak, inspMin, period);
+        return true;
+    }
+
+    // the last complete breath (NaN values before the first one).
+    const BreathMetrics &lastBreath() const { return last; }
+
+    // average over the breaths of the last window sec.
+    BreathMetrics average() const
+    {
+        if (count == 0)
+            return BreathMetrics{ last.time, nan(), nan(), nan() };
+        return BreathMetrics{ last.time,
+                              static_cast<float>(etSum / count),
+                              static_cast<float>(inspSum / count),
+                              static_cast<float>(60.0 * count / periodSum) };
+    }
+
+    // breaths in the averaging window.
+    size_t breathCount() const { return count; }
+
+private:
+    struct Breath
+    {
+        double time;
+        float etCO2;
+        float inspCO2;
+        double period;
+    };
+
+    // a 30 sec. window at the highest rate holds 75 breaths.
+    static const size_t maxBreaths = 256;
+
+    static float nan() { return std::numeric_limits<float>::quiet_NaN(); }
+
+    void startPhase(bool exhale, double time, float co2)
+    {
+        exhaling = exhale;
+        phaseStart = time;
+        phaseMin = phaseMax = co2;
+    }
+
+    // adds a breath to the window and drops the ones that fell out of it.
+    // Running sums keep it O(1) per breath (amortized).
+    void push(double time, float et, float insp, double period)
+    {
+        if (count == maxBreaths)
+            popFront();
+        breaths[(first + count) % maxBreaths] = Breath{ time, et, insp, period };
+        count++;
+        etSum += et;
+        inspSum += insp;
+        periodSum += period;
+        while (count > 1 && breaths[first].time < time - config.window)
+            popFront();
+    }
+
+    void popFront()
+    {
+        const Breath &b = breaths[first];
+        etSum -= b.etCO2;
+        inspSum -= b.inspCO2;
+        periodSum -= b.period;
+        first = (first + 1) % maxBreaths;
+        count--;
+    }
+
+    BreathDetectorConfig config;
+
+    bool exhaling;
+    double phaseStart;           // time the current phase began.
+    double exhaleStart;          // start of the current/last exhalation.
+    double previousExhaleStart;  // start of the one before, gives the period.
+    float phaseMin;              // lowest and highest CO2 in the current phase.
+    float phaseMax;
+    float inspMin;               // lowest CO2 of the last inhalation.
+    BreathMetrics last;
+
+    // ring of the breaths in the averaging window.
+    std::vector<Breath> breaths;
+    size_t first;
+    size_t count;
+    double etSum;
+    double inspSum;
+    double periodSum;
+};
+
+
+#endif // BREATHDETECTOR_H
@@ -0,0 +1,333 @@
+#ifndef CAPNOSIMULATOR_H
+#define CAPNOSIMULATOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "commons.h"
+#include "capnotrainer.h"
+
+
+// one virtual device behind the simulated dongle.
+struct SimulatedDevice
+{
+    DeviceType type;
+    uint8_t connHandle;
+    // CO2 and EMG: samples per second. HRV: ignored, one packet per heart beat.
+    double sampleRate;
+    size_t samplesPerPacket;
+};
+
+
+struct CapnoSimulatorConfig
+{
+    std::vector<SimulatedDevice> devices;
+
+    // 1 plays in real time, 10 ten times faster, 0 as fast as possible
+    // (throughput benchmark).
+    double speed = 1.0;
+    // simulated seconds after which the simulator stops by itself, 0 runs
+    // until stop() is called.
+    double duration = 0.0;
+    // same seed, same packets (timing aside).
+    uint32_t seed = 1;
+
+    // chance that a packet starts a burst: it and the next burstLength - 1
+    // packets of the device are held back and delivered back to back, like
+    // after a USB hiccup.
+    double burstProbability = 0.0;
+    size_t burstLength = 8;
+    // chance that a packet is lost, like a frame the library discards on a
+    // checksum error.
+    double dropProbability = 0.0;
+    // chance that a packet arrives with garbage values (spikes and NaN), like
+    // a frame that passes the checksum by accident.
+    double corruptProbability = 0.0;
+};
+
+
+// Simulates a CapnoTrainer dongle with any number of Go/HRV/EMG devices.
+//
+// The packets are handed to the same user_cb_t that is registered on
+// CapnoTrainer, from a thread of its own just like the asio io thread, so the
+// whole app side (view callback, ring buffers, graph) can be load tested and
+// benchmarked without hardware. Serial framing and checksums are handled
+// inside the prebuilt library, their failures show up here as dropped,
+// corrupted or bursty packets.
+class CapnoSimulator
+{
+public:
+    struct Statistics
+    {
+        uint64_t packets;
+        uint64_t samples;
+        uint64_t dropped;
+        uint64_t corrupted;
+        // time spent inside the user callback.
+        double callbackSeconds;
+        double maxCallbackSeconds;
+    };
+
+    CapnoSimulator(user_cb_t callback, const CapnoSimulatorConfig &config)
+        : callback(callback), config(config)
+    {
+    }
+
+    ~CapnoSimulator()
+    {
+        stop();
+    }
+
+    void start()
+    {
+        if (running.exchange(true))
+            return;
+        if (worker.joinable())
+            worker.join();
+        worker = std::thread(&CapnoSimulator::run, this);
+    }
+
+    void stop()
+    {
+        {
+            // under the lock, so the worker can't miss the wake up between
+            // checking running and starting to wait.
+            std::lock_guard<std::mutex> lock(waitMutex);
+            running.store(false);
+        }
+        wake.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool isRunning() const { return running.load(); }
+
+    // may be called from any thread while running.
+    Statistics statistics() const
+    {
+        Statistics s;
+        s.packets = packets.load(std::memory_order_relaxed);
+        s.samples = samples.load(std::memory_order_relaxed);
+        s.dropped = dropped.load(std::memory_order_relaxed);
+        s.corrupted = corrupted.load(std::memory_order_relaxed);
+        s.callbackSeconds = callbackNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        s.maxCallbackSeconds = maxCallbackNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        return s;
+    }
+
+private:
+    struct Packet
+    {
+        std::vector<float> data;
+        DataType type;
+    };
+
+    // per device generator state (simulator thread only).
+    struct DeviceState
+    {
+        SimulatedDevice device;
+        double nextTime;         // simulated time of the next packet.
+        uint64_t sampleIndex;
+        size_t burstRemaining;   // packets still to hold back.
+        std::deque<Packet> held;
+    };
+
+    void run()
+    {
+        std::mt19937 random(config.seed);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+        std::vector<DeviceState> states;
+        for (const SimulatedDevice &device : config.devices)
+            states.push_back(DeviceState{ device, 0.0, 0, 0, std::deque<Packet>() });
+
+        const auto startTime = std::chrono::steady_clock::now();
+        while (running.load() && !states.empty())
+        {
+            // the device whose next packet is due first.
+            DeviceState *state = &states[0];
+            for (DeviceState &s : states)
+                if (s.nextTime < state->nextTime)
+                    state = &s;
+
+            const double time = state->nextTime;
+            if (config.duration > 0 && time >= config.duration)
+                break;
+            if (config.speed > 0)
+            {
+                // slow simulations have long gaps, stop() must not wait them out.
+                const auto due = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(time / config.speed));
+                std::unique_lock<std::mutex> lock(waitMutex);
+                if (wake.wait_until(lock, due, [this]() { return !running.load(); }))
+                    break;
+            }
+
+            std::vector<Packet> generated;
+            state->nextTime = generate(*state, time, random, generated);
+
+            for (Packet &packet : generated)
+            {
+                if (chance(random) < config.dropProbability)
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                if (chance(random) < config.corruptProbability)
+                {
+                    corrupt(packet, random);
+                    corrupted.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (state->burstRemaining == 0 && config.burstLength > 1 && chance(random) < config.burstProbability)
+                    state->burstRemaining = config.burstLength;
+
+                state->held.push_back(std::move(packet));
+                if (state->burstRemaining > 0 && --state->burstRemaining > 0)
+                    continue;
+                while (!state->held.empty())
+                {
+                    deliver(state->held.front(), state->device);
+                    state->held.pop_front();
+                }
+            }
+        }
+        running.store(false);
+    }
+
+    // appends the packets that are due at time and returns the time of the
+    // next ones.
+    double generate(DeviceState &state, double time, std::mt19937 &random, std::vector<Packet> &out)
+    {
+        std::normal_distribution<float> noise(0.0f, 1.0f);
+        const SimulatedDevice &device = state.device;
+        const size_t count = std::max<size_t>(device.samplesPerPacket, 1);
+
+        switch (device.type)
+        {
+            case DONGLE_DEVTYPE_CAPNO_GO:
+            case DONGLE_DEVTYPE_CAPNO_6:
+            {
+                const double rate = device.sampleRate > 0 ? device.sampleRate : 100.0;
+                Packet co2{ std::vector<float>(count), DATA_CO2 };
+                for (size_t i = 0; i < count; i++)
+                {
+                    double t = (state.sampleIndex + i) / rate;
+                    co2.data[i] = std::max(0.0f, capnogram(t) + 0.2f * noise(random));
+                }
+                out.push_back(std::move(co2));
+
+                // the averages come once per breath, the battery every 10 sec.
+                const double nextTime = (state.sampleIndex + count) / rate;
+                if (std::floor(nextTime / breathPeriod) > std::floor(time / breathPeriod))
+                {
+                    out.push_back(Packet{ std::vector<float>(1, plateauCO2 + 0.5f * noise(random)), DATA_ETCO2_AVERAGE });
+                    out.push_back(Packet{ std::vector<float>(1, 0.0f), DATA_INSP_CO2_AVERAGE });
+                    out.push_back(Packet{ std::vector<float>(1, static_cast<float>(60.0 / breathPeriod)), DATA_BPM_AVERAGE });
+                }
+                if (std::floor(nextTime / 10.0) > std::floor(time / 10.0))
+                    out.push_back(Packet{ std::vector<float>(1, static_cast<float>(std::max(0.0, 100.0 - time / 60.0))), DATA_CAPNO_BATTERY });
+
+                state.sampleIndex += count;
+                return nextTime;
+            }
+
+            case DONGLE_DEVTYPE_HRV:
+            {
+                // ~70 BPM with respiratory sinus arrhythmia.
+                const double pi = 3.14159265358979323846;
+                float rr = static_cast<float>(857.0 + 40.0 * std::sin(2.0 * pi * time / breathPeriod)) + 10.0f * noise(random);
+                out.push_back(Packet{ std::vector<float>(1, rr), DATA_RR_INTERVALS });
+                out.push_back(Packet{ std::vector<float>(1, 60000.0f / rr), DATA_HEART_RATE });
+                state.sampleIndex += 1;
+                return time + rr / 1000.0;
+            }
+
+            case DONGLE_DEVTYPE_EMG:
+            {
+                const double rate = device.sampleRate > 0 ? device.sampleRate : 1000.0;
+                Packet emg{ std::vector<float>(count), DATA_EMG };
+                for (size_t i = 0; i < count; i++)
+                {
+                    // bursts of muscle activity every few seconds.
+                    double t = (state.sampleIndex + i) / rate;
+                    float envelope = std::fmod(t, 4.0) < 1.0 ? 50.0f : 5.0f;
+                    emg.data[i] = envelope * noise(random);
+                }
+                out.push_back(std::move(emg));
+                state.sampleIndex += count;
+                return state.sampleIndex / rate;
+            }
+
+            default:
+                return std::numeric_limits<double>::infinity();
+        }
+    }
+
+    // raw CO2 (in mmHg) of a calm breath at time t (in sec.).
+    static float capnogram(double t)
+    {
+        double phase = std::fmod(t, breathPeriod) / breathPeriod;
+        if (phase < 0.40) // inspiration
+            return 0.0f;
+        if (phase < 0.48) // expiratory upstroke
+            return static_cast<float>(plateauCO2 * 0.9 * (phase - 0.40) / 0.08);
+        if (phase < 0.92) // alveolar plateau, slowly rising to end-tidal
+            return static_cast<float>(plateauCO2 * (0.9 + 0.1 * (phase - 0.48) / 0.44));
+        return static_cast<float>(plateauCO2 * (1.0 - (phase - 0.92) / 0.08)); // inspiratory downstroke
+    }
+
+    void corrupt(Packet &packet, std::mt19937 &random)
+    {
+        std::uniform_int_distribution<size_t> index(0, packet.data.size() - 1);
+        std::uniform_real_distribution<float> garbage(-1e4f, 1e4f);
+        packet.data[index(random)] = garbage(random);
+        packet.data[index(random)] = std::numeric_limits<float>::quiet_NaN();
+    }
+
+    void deliver(const Packet &packet, const SimulatedDevice &device)
+    {
+        const auto before = std::chrono::steady_clock::now();
+        callback(packet.data, device.type, device.connHandle, packet.type);
+        const uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - before).count();
+
+        packets.fetch_add(1, std::memory_order_relaxed);
+        samples.fetch_add(packet.data.size(), std::memory_order_relaxed);
+        callbackNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        // only the simulator thread writes it.
+        if (nanoseconds > maxCallbackNanoseconds.load(std::memory_order_relaxed))
+            maxCallbackNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+    }
+
+    static constexpr double breathPeriod = 5.0; // in sec., 12 BPM.
+    static constexpr float plateauCO2 = 38.0f;  // in mmHg.
+
+    user_cb_t callback;
+    CapnoSimulatorConfig config;
+
+    std::atomic<bool> running{false};
+    std::thread worker;
+    std::mutex waitMutex;
+    std::condition_variable wake;    // stop() interrupts the wait for the next packet.
+
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> corrupted{0};
+    std::atomic<uint64_t> callbackNanoseconds{0};
+    std::atomic<uint64_t> maxCallbackNanoseconds{0};
+};
+
+
+#endif // CAPNOSIMULATOR_H
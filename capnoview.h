@@ -0,0 +1,93 @@
+#ifndef CAPNOVIEW_H
+#define CAPNOVIEW_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "commons.h"
+#include "capnotrainer.h"
+#include "sampleclock.h"
+
+
+// Non-owning view on the samples of one packet.
+//
+// data points into the vector the library hands to the user callback, so the
+// view is only valid until the callback returns. sequence counts the packets
+// per connection handle and data type, a gap means that packets were lost.
+//
+// time is the time (in sec. since the callback was made) of data[0], sample i
+// was taken at time + i * period. For the CO2 and EMG waveforms it comes from
+// the recovered device clock (see SampleClock), for everything else it is the
+// arrival time and period is 0.
+struct CapnoSampleView
+{
+    const float *data;
+    size_t length;
+    uint64_t sequence;
+    double time;
+    double period;
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const float *begin() const { return data; }
+    const float *end() const { return data + length; }
+    float operator[](size_t i) const { return data[i]; }
+    float at(size_t i) const
+    {
+        if (i >= length)
+            throw std::out_of_range("CapnoSampleView::at");
+        return data[i];
+    }
+};
+
+typedef std::function<void(const CapnoSampleView &data, DeviceType device_type, uint8_t conn_handle, DataType data_type)> user_view_cb_t;
+
+
+// Wraps a view callback so it can be registered on CapnoTrainer.
+//
+// CapnoTrainer calls user_cb_t with the vector by value, that one copy happens
+// inside the (prebuilt) library. Everything after it works on the view, so
+// the user code does not need to copy the samples again.
+//
+// The sample clocks assume that the packets of one connection handle come from
+// one thread at a time, which holds for the asio read handlers.
+inline user_cb_t MakeViewCallback(user_view_cb_t view_cb)
+{
+    // one counter per connection handle and data type.
+    const size_t data_types = DATA_CAPNO_STATUS + 1;
+    std::shared_ptr<std::array<std::atomic<uint64_t>, 256 * data_types>> sequences(
+                new std::array<std::atomic<uint64_t>, 256 * data_types>());
+    for (auto &sequence : *sequences)
+        sequence.store(0, std::memory_order_relaxed);
+
+    // one clock per connection handle for each waveform. The Go samples
+    // CO2 at almost 100 Hz, the EMG rate is measured.
+    std::shared_ptr<std::vector<SampleClock>> co2Clocks(new std::vector<SampleClock>(256, SampleClock(100.0)));
+    std::shared_ptr<std::vector<SampleClock>> emgClocks(new std::vector<SampleClock>(256, SampleClock()));
+    const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+    return [view_cb, sequences, co2Clocks, emgClocks, origin](std::vector<float> data, DeviceType device_type, uint8_t conn_handle, DataType data_type)
+    {
+        const double arrival = std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+
+        uint64_t sequence = 0;
+        if (data_type < data_types)
+            sequence = (*sequences)[conn_handle * data_types + data_type].fetch_add(1, std::memory_order_relaxed);
+
+        CapnoSampleView view = { data.data(), data.size(), sequence, arrival, 0.0 };
+        if (data_type == DATA_CO2)
+            view.time = (*co2Clocks)[conn_handle].update(arrival, data.size(), view.period);
+        else if (data_type == DATA_EMG)
+            view.time = (*emgClocks)[conn_handle].update(arrival, data.size(), view.period);
+        view_cb(view, device_type, conn_handle, data_type);
+    };
+}
+
+
+#endif // CAPNOVIEW_H
@@ -0,0 +1,259 @@
+#ifndef HRVANALYZER_H
+#define HRVANALYZER_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "commons.h"
+#include "capnoview.h"
+
+
+// Data types the HrvAnalyzer adds to the callback, after the ones of the
+// library (the DataType enum ends with DATA_CAPNO_STATUS).
+//
+// DATA_HRV_TIME_DOMAIN, after every beat:
+//   [0] mean RR (ms), [1] SDNN (ms), [2] RMSSD (ms), [3] pNN50 (%), [4] heart rate (BPM)
+// DATA_HRV_SPECTRUM, whenever the window moved by spectrumInterval:
+//   [0] LF power (0.04 - 0.15 Hz, ~ms^2), [1] HF power (0.15 - 0.4 Hz, ~ms^2), [2] LF/HF
+const DataType DATA_HRV_TIME_DOMAIN = static_cast<DataType>(DATA_CAPNO_STATUS + 1);
+const DataType DATA_HRV_SPECTRUM = static_cast<DataType>(DATA_CAPNO_STATUS + 2);
+
+
+struct HrvAnalyzerConfig
+{
+    // all values are taken over the beats of the last window sec.
+    double window = 300.0;
+    // the spectrum is recomputed when the window moved by this many sec.
+    double spectrumInterval = 5.0;
+    // and only when the window holds at least this many sec. of beats,
+    // shorter spans can't resolve LF.
+    double minSpectrumSpan = 60.0;
+};
+
+
+// Streaming heart rate variability of one HRV device.
+//
+// Takes the DATA_RR_INTERVALS packets (RR in ms) and keeps the beats of a
+// sliding window in a ring with running sums, so SDNN, RMSSD and pNN50 cost
+// O(1) per beat. The LF/HF spectrum (Lomb-Scargle periodogram, it handles the
+// unevenly spaced beats without resampling) is O(beats * frequencies) and
+// therefore only recomputed as the window advances, the cached values are
+// handed out in between. Results go to the output callback as the data types
+// above, so every consumer gets them without recomputing anything.
+//
+// Intervals outside 300 - 2000 ms or more than 20% off the previous one
+// (artifacts, ectopic beats) are skipped. Not thread-safe, feed it from one
+// thread.
+class HrvAnalyzer
+{
+public:
+    HrvAnalyzer(user_view_cb_t output, const HrvAnalyzerConfig &config = HrvAnalyzerConfig())
+        : output(output), config(config),
+          beats(static_cast<size_t>(config.window / (minRR / 1000.0)) + 2)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        first = 0;
+        count = 0;
+        rrSum = rrSquareSum = diffSquareSum = 0;
+        nn50Count = 0;
+        beatTime = std::numeric_limits<double>::quiet_NaN();
+        previousRR = std::numeric_limits<double>::quiet_NaN();
+        lastSpectrumTime = -std::numeric_limits<double>::infinity();
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        timeDomainValues = { nan, nan, nan, nan, nan };
+        spectrumValues = { nan, nan, nan };
+        sequence = 0;
+        spectrumSequence = 0;
+    }
+
+    // rr holds one or more intervals, rr.time is taken as the time of the
+    // first beat if the beats were interrupted.
+    void addIntervals(const CapnoSampleView &rr, uint8_t conn_handle)
+    {
+        for (size_t i = 0; i < rr.size(); i++)
+        {
+            // a gap longer than the window (device reconnected): start over.
+            if (!std::isnan(beatTime) && rr.time - beatTime > config.window)
+                reset();
+            if (std::isnan(beatTime))
+                beatTime = rr.time;
+            else
+                beatTime += rr[i] / 1000.0;
+
+            if (addBeat(beatTime, rr[i]))
+                publish(conn_handle);
+        }
+    }
+
+    // mean RR, SDNN, RMSSD, pNN50, heart rate (see DATA_HRV_TIME_DOMAIN).
+    const std::vector<float> &timeDomain() const { return timeDomainValues; }
+    // LF, HF, LF/HF (see DATA_HRV_SPECTRUM), NaN until the window is long enough.
+    const std::vector<float> &spectrum() const { return spectrumValues; }
+
+private:
+    struct Beat
+    {
+        double time;   // in sec.
+        double rr;     // in ms.
+        double diff;   // to the previous beat in the window, 0 for the first.
+    };
+
+    static constexpr double minRR = 300.0;
+    static constexpr double maxRR = 2000.0;
+
+    const Beat &beat(size_t i) const { return beats[(first + i) % beats.size()]; }
+
+    // returns false if the interval was skipped.
+    bool addBeat(double time, double rr)
+    {
+        // compared to the previous interval as received, so that a real
+        // change of the heart rate only costs one beat.
+        const double previous = previousRR;
+        previousRR = rr;
+        if (!(rr >= minRR && rr <= maxRR))
+            return false;
+        if (!std::isnan(previous) && std::fabs(rr - previous) > 0.2 * previous)
+            return false;
+
+        if (count == beats.size())
+            popFront();
+        const double diff = count > 0 ? rr - beat(count - 1).rr : 0.0;
+        beats[(first + count) % beats.size()] = Beat{ time, rr, diff };
+        count++;
+        rrSum += rr;
+        rrSquareSum += rr * rr;
+        if (count > 1)
+        {
+            diffSquareSum += diff * diff;
+            nn50Count += std::fabs(diff) > 50.0;
+        }
+        while (count > 1 && beat(0).time < time - config.window)
+            popFront();
+        return true;
+    }
+
+    void popFront()
+    {
+        const Beat &b = beat(0);
+        rrSum -= b.rr;
+        rrSquareSum -= b.rr * b.rr;
+        first = (first + 1) % beats.size();
+        count--;
+        // the next beat becomes the first one, its difference leaves the window.
+        if (count > 0)
+        {
+            Beat &next = beats[first];
+            diffSquareSum -= next.diff * next.diff;
+            nn50Count -= std::fabs(next.diff) > 50.0;
+            next.diff = 0.0;
+        }
+    }
+
+    void publish(uint8_t conn_handle)
+    {
+        const double mean = rrSum / count;
+        const double variance = count > 1 ? std::fmax(0.0, (rrSquareSum - rrSum * mean) / (count - 1)) : 0.0;
+        const size_t diffs = count - 1;
+        timeDomainValues[0] = static_cast<float>(mean);
+        timeDomainValues[1] = static_cast<float>(std::sqrt(variance));
+        timeDomainValues[2] = diffs > 0 ? static_cast<float>(std::sqrt(std::fmax(0.0, diffSquareSum) / diffs)) : 0.0f;
+        timeDomainValues[3] = diffs > 0 ? static_cast<float>(100.0 * nn50Count / diffs) : 0.0f;
+        timeDomainValues[4] = static_cast<float>(60000.0 / mean);
+
+        const double now = beat(count - 1).time;
+        CapnoSampleView timeView = { timeDomainValues.data(), timeDomainValues.size(), sequence++, now, 0.0 };
+        output(timeView, DONGLE_DEVTYPE_HRV, conn_handle, DATA_HRV_TIME_DOMAIN);
+
+        if (now - lastSpectrumTime >= config.spectrumInterval && now - beat(0).time >= config.minSpectrumSpan)
+        {
+            lastSpectrumTime = now;
+            updateSpectrum();
+            CapnoSampleView spectrumView = { spectrumValues.data(), spectrumValues.size(), spectrumSequence++, now, 0.0 };
+            output(spectrumView, DONGLE_DEVTYPE_HRV, conn_handle, DATA_HRV_SPECTRUM);
+        }
+    }
+
+    // Lomb-Scargle periodogram of the RR series over the window, summed up
+    // over the LF and HF bands.
+    void updateSpectrum()
+    {
+        const double pi = 3.14159265358979323846;
+        const double mean = rrSum / count;
+        const double span = beat(count - 1).time - beat(0).time;
+        // the peaks are 1 / span wide, a finer grid would just cost time,
+        // a coarser one misses part of their power.
+        const double step = 1.0 / span; // Hz
+
+        double lf = 0, hf = 0;
+        for (double f = 0.04 + step / 2; f < 0.4; f += step)
+        {
+            const double omega = 2 * pi * f;
+
+            // tau makes the sine and cosine terms independent.
+            double s2 = 0, c2 = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                s2 += std::sin(2 * omega * beat(i).time);
+                c2 += std::cos(2 * omega * beat(i).time);
+            }
+            const double tau = std::atan2(s2, c2) / (2 * omega);
+
+            double yc = 0, ys = 0, cc = 0, ss = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                const double phase = omega * (beat(i).time - tau);
+                const double c = std::cos(phase), s = std::sin(phase);
+                const double y = beat(i).rr - mean;
+                yc += y * c;
+                ys += y * s;
+                cc += c * c;
+                ss += s * s;
+            }
+            // scaled so that a sine of amplitude A gives A^2 / 2 over the band.
+            double power = 0;
+            if (cc > 0)
+                power += yc * yc / cc;
+            if (ss > 0)
+                power += ys * ys / ss;
+            power *= step * span / count;
+
+            if (f < 0.15)
+                lf += power;
+            else
+                hf += power;
+        }
+        spectrumValues[0] = static_cast<float>(lf);
+        spectrumValues[1] = static_cast<float>(hf);
+        spectrumValues[2] = hf > 0 ? static_cast<float>(lf / hf) : std::numeric_limits<float>::quiet_NaN();
+    }
+
+    user_view_cb_t output;
+    HrvAnalyzerConfig config;
+
+    // ring of the beats in the window.
+    std::vector<Beat> beats;
+    size_t first;
+    size_t count;
+    double rrSum;
+    double rrSquareSum;
+    double diffSquareSum;   // successive differences within the window.
+    size_t nn50Count;       // of those, the ones above 50 ms.
+
+    double beatTime;        // time of the last beat, NaN before the first.
+    double previousRR;      // last interval received (skipped or not).
+    double lastSpectrumTime;
+    std::vector<float> timeDomainValues;
+    std::vector<float> spectrumValues;
+    uint64_t sequence;
+    uint64_t spectrumSequence;
+};
+
+
+#endif // HRVANALYZER_H
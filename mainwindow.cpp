@@ -3,17 +3,19 @@
 #include <QSerialPortInfo>
 #include <QSharedPointer>
 #include <QMessageBox>
+#include <QDateTime>
+#include <QFileInfo>
 #include <cmath>
 
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    capnoTrainer(std::bind(&MainWindow::userCapnoCallback, this,
-                          std::placeholders::_1,
-                          std::placeholders::_2,
-                          std::placeholders::_3,
-                          std::placeholders::_4),
+    capnoTrainer(MakeViewCallback(std::bind(&MainWindow::userCapnoCallback, this,
+                                            std::placeholders::_1,
+                                            std::placeholders::_2,
+                                            std::placeholders::_3,
+                                            std::placeholders::_4)),
                  false
           )
 {
@@ -25,12 +27,14 @@ MainWindow::MainWindow(QWidget *parent) :
     petCO2Label = new QLabel(this);
     insCO2Label = new QLabel(this);
     bpmLabel = new QLabel(this);
+    hrvLabel = new QLabel(this);
     batteryLabel = new QLabel(this);
 
     // set text for the label
     petCO2Label->setText("PetCO2: 0 mmHg \t\t");
     insCO2Label->setText("Insp. CO2: 0 mmHg \t\t");
     bpmLabel->setText("Resp. Rate: 0 BPM\t");
+    hrvLabel->setText("HRV: N/A\t");
     batteryLabel->setText("Battery: N/A\t");
     statusLabel->setText("Status: N/A\t");
 
@@ -38,6 +42,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->statusBar->addPermanentWidget(petCO2Label);
     ui->statusBar->addPermanentWidget(insCO2Label);
     ui->statusBar->addPermanentWidget(bpmLabel);
+    ui->statusBar->addPermanentWidget(hrvLabel);
     ui->statusBar->addPermanentWidget(batteryLabel);
     ui->statusBar->addPermanentWidget(statusLabel);
 
@@ -62,56 +67,201 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->customPlot->yAxis->setRange(0, 50);
     QSharedPointer<TimeAxisTicker> timeTicker(new TimeAxisTicker);
     ui->customPlot->xAxis->setTicker(timeTicker);
+    // keep memory constant for long sessions, a little more than the visible window.
+    ui->customPlot->graph(0)->data()->setFixedCapacity(static_cast<int>(1.1 * co2MaxTime * co2Rate / co2DataDownsample));
+    // the graph gets its own paint buffer that is shifted along the time axis,
+    // so a replot only draws the newly exposed strip instead of the whole curve.
+    ui->customPlot->layer("main")->setMode(QCPLayer::lmBuffered);
+    ui->customPlot->layer("main")->setScrollAxis(ui->customPlot->xAxis);
+    // the ticks and labels of the time axis move with every scroll step, those
+    // of the other axes only when their range changes. The time axis goes one
+    // layer up, then the "axes" buffer is only redrawn when the others change.
+    // No selection rect is used here, so the overlay shares the buffer of the
+    // time axis instead of adding one.
+    ui->customPlot->layer("axes")->setMode(QCPLayer::lmBuffered);
+    ui->customPlot->layer("axes")->setAxisCache(true);
+    ui->customPlot->layer("overlay")->setMode(QCPLayer::lmLogical);
+    ui->customPlot->xAxis->setLayer("legend");
 
     // setup graph timer (10Hz is perceived as real time).
     connect(&graphPlotTimer, &QTimer::timeout, this, &MainWindow::updateGraph);
     graphPlotTimer.start(50);
 
+    // CAPNO_RECORD=<file> records the session (all devices and data types).
+    if (qEnvironmentVariableIsSet("CAPNO_RECORD"))
+    {
+        QString fileName = QString::fromLocal8Bit(qgetenv("CAPNO_RECORD"));
+        // opening truncates the file, it must not be the one being replayed.
+        QFileInfo recordInfo(fileName);
+        QFileInfo replayInfo(QString::fromLocal8Bit(qgetenv("CAPNO_REPLAY")));
+        bool replayedFile = qEnvironmentVariableIsSet("CAPNO_REPLAY") &&
+                (recordInfo.absoluteFilePath() == replayInfo.absoluteFilePath() ||
+                 (recordInfo.exists() && recordInfo.canonicalFilePath() == replayInfo.canonicalFilePath()));
+        if (replayedFile)
+            std::cout << "Not recording, " << fileName.toStdString() << " is the file being replayed" << std::endl;
+        else if (!recorder.open(fileName, QDateTime::currentMSecsSinceEpoch()))
+            std::cout << "Can't record to " << fileName.toStdString() << std::endl;
+    }
+
+    // the simulator and the replay stand in for the dongle, only one source
+    // may run at a time: they would share co2Ring, co2Samples and the
+    // analyzers, and mix their time bases on the graph.
+    bool simulate = qEnvironmentVariableIsSet("CAPNO_SIMULATE");
+    bool replaySession = qEnvironmentVariableIsSet("CAPNO_REPLAY");
+    if (simulate && replaySession)
+    {
+        std::cout << "CAPNO_SIMULATE and CAPNO_REPLAY can't be used together, starting neither." << std::endl;
+        statusLabel->setText("Status: Set either CAPNO_SIMULATE or CAPNO_REPLAY\t");
+        simulate = replaySession = false;
+    }
+
+    // CAPNO_SIMULATE=1 runs the app against a simulated CapnoTrainer Go
+    // (no dongle needed), handy for load testing the graph.
+    if (simulate)
+    {
+        CapnoSimulatorConfig config;
+        config.devices.push_back(SimulatedDevice{ DONGLE_DEVTYPE_CAPNO_GO, 0, co2Rate, 10 });
+        simulator.reset(new CapnoSimulator(MakeViewCallback(std::bind(&MainWindow::userCapnoCallback, this,
+                                                                      std::placeholders::_1,
+                                                                      std::placeholders::_2,
+                                                                      std::placeholders::_3,
+                                                                      std::placeholders::_4)),
+                                           config));
+        simulator->start();
+        statusLabel->setText("Status: Simulated\t");
+        // the dongle can't be connected next to it.
+        ui->connectBtn->setEnabled(false);
+    }
+
+    // CAPNO_REPLAY=<file> plays a recorded session at CAPNO_REPLAY_SPEED
+    // times real time (default 1, 0 is as fast as possible).
+    if (replaySession)
+    {
+        QString fileName = QString::fromLocal8Bit(qgetenv("CAPNO_REPLAY"));
+        bool speedOk = false;
+        double speed = QString::fromLocal8Bit(qgetenv("CAPNO_REPLAY_SPEED")).toDouble(&speedOk);
+        replay.reset(new SessionReplay(user_view_cb_t(std::bind(&MainWindow::userCapnoCallback, this,
+                                                                std::placeholders::_1,
+                                                                std::placeholders::_2,
+                                                                std::placeholders::_3,
+                                                                std::placeholders::_4)),
+                                       fileName, speedOk ? speed : 1.0));
+        if (replay->start())
+        {
+            statusLabel->setText("Status: Replaying\t");
+            ui->connectBtn->setEnabled(false);
+        } else
+            statusLabel->setText(QString("Status: Can't replay %1\t").arg(fileName));
+    }
 }
 
 MainWindow::~MainWindow()
 {
+    // the simulator and replay threads call into this window, stop them first.
+    simulator.reset();
+    replay.reset();
     delete ui;
 }
 
-void MainWindow::updateGraph()
+void MainWindow::updateStatusLabels()
 {
-    // calculate two new data points:
-    QVector<double> xData;
-    QVector<double> yData;
-    QMutexLocker locker(&dataMutex);
+    float battery = statusValues.battery.load(std::memory_order_relaxed);
+    float petCO2 = statusValues.petCO2.load(std::memory_order_relaxed);
+    float insCO2 = statusValues.insCO2.load(std::memory_order_relaxed);
+    float bpm = statusValues.bpm.load(std::memory_order_relaxed);
+    float rmssd = statusValues.rmssd.load(std::memory_order_relaxed);
+    float lfHf = statusValues.lfHf.load(std::memory_order_relaxed);
+
+    // labels that never got a value keep their placeholder text.
+    bool batteryChanged = !std::isnan(battery) && battery != shownBattery;
+    bool petCO2Changed = !std::isnan(petCO2) && petCO2 != shownPetCO2;
+    bool insCO2Changed = !std::isnan(insCO2) && insCO2 != shownInsCO2;
+    bool bpmChanged = !std::isnan(bpm) && bpm != shownBpm;
+    // LF/HF stays NaN for the first minute of beats.
+    bool hrvChanged = !std::isnan(rmssd) && (rmssd != shownRmssd ||
+                                             (!std::isnan(lfHf) && lfHf != shownLfHf));
+
+    if (!batteryChanged && !petCO2Changed && !insCO2Changed && !bpmChanged && !hrvChanged)
+        return;
 
-    while (!co2Queue.empty())
+    // set all changed labels in one go, the status bar relayouts once.
+    ui->statusBar->setUpdatesEnabled(false);
+    if (batteryChanged)
     {
-        std::vector<float> data = co2Queue.front();
-        co2Queue.pop();
+        batteryLabel->setText(QString("Battery: %1 %\t").arg(battery));
+        shownBattery = battery;
+    }
+    if (petCO2Changed)
+    {
+        petCO2Label->setText(QString("PetCO2 (Average): %1 mmHg\t").arg(petCO2));
+        shownPetCO2 = petCO2;
+    }
+    if (insCO2Changed)
+    {
+        insCO2Label->setText(QString("Insp. CO2 (Average): %1 mmHg\t").arg(insCO2));
+        shownInsCO2 = insCO2;
+    }
+    if (bpmChanged)
+    {
+        bpmLabel->setText(QString("Resp. Rate (Average): %1 BPM\t").arg(bpm));
+        shownBpm = bpm;
+    }
+    if (hrvChanged)
+    {
+        hrvLabel->setText(QString("HRV RMSSD: %1 ms  LF/HF: %2\t")
+                          .arg(rmssd).arg(std::isnan(lfHf) ? QString("N/A") : QString::number(lfHf)));
+        shownRmssd = rmssd;
+        shownLfHf = lfHf;
+    }
+    ui->statusBar->setUpdatesEnabled(true);
+}
+
+void MainWindow::updateGraph()
+{
+    updateStatusLabels();
+
+    // move the new data points straight into the graph (never blocks the callback threads):
+    QCPGraphDataContainer *graphData = ui->customPlot->graph(0)->data().data();
+    double lastTime = 0;
 
-        // here you can downsample the data.
-        for (size_t i = 0; i < data.size(); i+=co2DataDownsample )
+    size_t newSamples = co2Ring.consume([&](const TimedSample *samples, size_t count)
+    {
+        QCPGraphDataContainer::iterator it = graphData->prepareAppend(static_cast<int>(count));
+        for (size_t i = 0; i < count; i++, ++it)
         {
-            xData.push_back(((double)co2Samples / (co2Rate/co2DataDownsample)) );
-            yData.push_back((double) data.at( i ));
-            co2Samples += 1;
+            it->key = samples[i].time;
+            it->value = (double) samples[i].value;
         }
-    }
+        graphData->finishAppend(static_cast<int>(count));
+        lastTime = samples[count-1].time;
+    });
 
     // in case the queue is already empty (when the GO is not turned on).
-    if (xData.size() > 0){
-
-        double max_time = 60 ; // in seconds
-        ui->customPlot->graph(0)->addData(xData, yData);
-        // make key axis range scroll with the data (at a constant range):
-        ui->customPlot->xAxis->setRange( xData.at(xData.size()-1) +0.25, max_time, Qt::AlignRight);
+    if (newSamples > 0){
+
+        // make key axis range scroll with the data (at a constant range).
+        // the right end is rounded up to whole pixels, otherwise the plot
+        // can't shift its buffer and has to redraw everything.
+        double rightTime = lastTime + 0.25;
+        int plotWidth = ui->customPlot->axisRect()->width();
+        if (plotWidth > 0)
+        {
+            double pixelsPerSecond = plotWidth / co2MaxTime;
+            rightTime = std::ceil(rightTime * pixelsPerSecond) / pixelsPerSecond;
+        }
+        ui->customPlot->xAxis->setRange(rightTime, co2MaxTime, Qt::AlignRight);
         ui->customPlot->yAxis->setRange(0, 40);
-        ui->customPlot->graph(0)->data()->removeBefore( xData.at(xData.size()-1) - max_time );
+        graphData->removeBefore( lastTime - co2MaxTime );
         ui->customPlot->replot();
     }
 }
 
 
-void MainWindow::userCapnoCallback(std::vector<float> data, DeviceType device_type, uint8_t conn_handle, DataType data_type)
+void MainWindow::userCapnoCallback(const CapnoSampleView &data, DeviceType device_type, uint8_t conn_handle, DataType data_type)
 {
-    QMutexLocker locker(&dataMutex);
+    // the HRV results are derived from the recorded RR intervals.
+    if (data_type <= DATA_CAPNO_STATUS)
+        recorder.record(data, device_type, conn_handle, data_type);
 
     switch (device_type)
     {
@@ -119,23 +269,49 @@ void MainWindow::userCapnoCallback(std::vector<float> data, DeviceType device_ty
         {
             if (data_type == DATA_CO2)
             {
-                co2Queue.push(data);
+                std::unique_ptr<BreathDetector> &breaths = co2Breaths[conn_handle];
+                if (!breaths)
+                    breaths.reset(new BreathDetector());
+
+                // here you can downsample the data.
+                for (size_t i = 0; i < data.size(); i++)
+                {
+                    double time = data.time + i * data.period;
+                    if (co2Samples.fetch_add(1, std::memory_order_relaxed) % co2DataDownsample == 0)
+                        co2Ring.push(TimedSample{ time, data[i] });
+
+                    // the averages are updated with every breath, no need
+                    // to wait for the ones from the device.
+                    if (breaths->addSample(time, data[i]))
+                    {
+                        // one decimal is all the labels show.
+                        BreathMetrics average = breaths->average();
+                        statusValues.petCO2.store(std::round(average.etCO2 * 10) / 10, std::memory_order_relaxed);
+                        statusValues.insCO2.store(std::round(average.inspCO2 * 10) / 10, std::memory_order_relaxed);
+                        statusValues.bpm.store(std::round(average.bpm * 10) / 10, std::memory_order_relaxed);
+                    }
+                }
             }
             if (data_type == DATA_CAPNO_BATTERY)
             {
-                batteryLabel->setText(QString("Battery: %1 %\t").arg(data.at(0)));
+                statusValues.battery.store(data.at(0), std::memory_order_relaxed);
             }
-            if (data_type == DATA_ETCO2_AVERAGE)
+            // the device averages are only shown while no breath was measured
+            // here lately (same time base, both come from the callback).
+            const BreathDetector *breaths = co2Breaths[conn_handle].get();
+            bool measured = breaths && breaths->breathCount() > 0 &&
+                    data.time - breaths->lastBreath().time <= co2BreathsStaleAfter;
+            if (data_type == DATA_ETCO2_AVERAGE && !measured)
             {
-                petCO2Label->setText(QString("PetCO2 (Average): %1 mmHg\t").arg(data.at(0)));
+                statusValues.petCO2.store(data.at(0), std::memory_order_relaxed);
             }
-            if (data_type == DATA_INSP_CO2_AVERAGE)
+            if (data_type == DATA_INSP_CO2_AVERAGE && !measured)
             {
-                insCO2Label->setText(QString("Insp. CO2 (Average): %1 mmHg\t").arg(data.at(0)));
+                statusValues.insCO2.store(data.at(0), std::memory_order_relaxed);
             }
-            if (data_type == DATA_BPM_AVERAGE)
+            if (data_type == DATA_BPM_AVERAGE && !measured)
             {
-                bpmLabel->setText(QString("Resp. Rate (Average): %1 BPM\t").arg(data.at(0)));
+                statusValues.bpm.store(data.at(0), std::memory_order_relaxed);
             }
 
             if (data_type == DATA_CAPNO_STATUS)
@@ -159,11 +335,28 @@ void MainWindow::userCapnoCallback(std::vector<float> data, DeviceType device_ty
             if (data_type == DATA_RR_INTERVALS)
             {
                 std::cout << "Received RR-interval data with length: " << data.at(0) << "  with handle: " << (int)conn_handle << std::endl;
+                std::unique_ptr<HrvAnalyzer> &analyzer = hrv[conn_handle];
+                if (!analyzer)
+                    analyzer.reset(new HrvAnalyzer(std::bind(&MainWindow::userCapnoCallback, this,
+                                                             std::placeholders::_1,
+                                                             std::placeholders::_2,
+                                                             std::placeholders::_3,
+                                                             std::placeholders::_4)));
+                analyzer->addIntervals(data, conn_handle);
             }
             if (data_type == DATA_HEART_RATE)
             {
                 std::cout << "Heart Rate" << std::endl;
             }
+            // the labels show one decimal of RMSSD and two of LF/HF.
+            if (data_type == DATA_HRV_TIME_DOMAIN)
+            {
+                statusValues.rmssd.store(std::round(data.at(2) * 10) / 10, std::memory_order_relaxed);
+            }
+            if (data_type == DATA_HRV_SPECTRUM)
+            {
+                statusValues.lfHf.store(std::round(data.at(2) * 100) / 100, std::memory_order_relaxed);
+            }
         }
         break;
 
@@ -182,7 +375,10 @@ void MainWindow::userCapnoCallback(std::vector<float> data, DeviceType device_ty
 void MainWindow::onClearGraphBtnClicked(){
 
        std::cout << ui->customPlot->graph(0)->dataCount() << std::endl;
+       std::cout << "CO2 samples dropped: " << co2Ring.overflowCount() << std::endl;
        ui->customPlot->graph(0)->data()->clear();
+       // removed data can't be scrolled away, draw the graph layer from scratch.
+       ui->customPlot->layer("main")->setScrollAxis(ui->customPlot->xAxis);
        ui->customPlot->replot();
 }
 
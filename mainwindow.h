@@ -1,20 +1,30 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
-#include <queue>
 #include <vector>
+#include <array>
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
 
 #include <QMainWindow>
 #include <QThread>
-#include <QMutex>
 #include <QTimer>
 #include <QLabel>
 
 
 #include "commons.h"
 #include "capnotrainer.h"
+#include "capnoview.h"
+#include "capnosimulator.h"
+#include "sessionrecorder.h"
+#include "sessionreplay.h"
 #include "qcustomplot.h"
+#include "timeaxisticker.h"
+#include "sampleringbuffer.h"
+#include "breathdetector.h"
+#include "hrvanalyzer.h"
 
 namespace Ui {
 class MainWindow;
@@ -39,30 +49,80 @@ private:
     QLabel *insCO2Label;
     QLabel *batteryLabel;
     QLabel *bpmLabel;
+    QLabel *hrvLabel;
 
-    void userCapnoCallback(std::vector<float> data, DeviceType device_type, uint8_t conn_handle, DataType data_type);
+    // latest averaged values, written by the io thread and read once per
+    // frame by the graph timer. NaN means nothing was received yet.
+    struct StatusValues
+    {
+        std::atomic<float> battery{std::numeric_limits<float>::quiet_NaN()};
+        std::atomic<float> petCO2{std::numeric_limits<float>::quiet_NaN()};
+        std::atomic<float> insCO2{std::numeric_limits<float>::quiet_NaN()};
+        std::atomic<float> bpm{std::numeric_limits<float>::quiet_NaN()};
+        std::atomic<float> rmssd{std::numeric_limits<float>::quiet_NaN()};
+        std::atomic<float> lfHf{std::numeric_limits<float>::quiet_NaN()};
+    };
+    StatusValues statusValues;
+
+    // what the labels currently show (GUI thread only).
+    float shownBattery = std::numeric_limits<float>::quiet_NaN();
+    float shownPetCO2 = std::numeric_limits<float>::quiet_NaN();
+    float shownInsCO2 = std::numeric_limits<float>::quiet_NaN();
+    float shownBpm = std::numeric_limits<float>::quiet_NaN();
+    float shownRmssd = std::numeric_limits<float>::quiet_NaN();
+    float shownLfHf = std::numeric_limits<float>::quiet_NaN();
+
+    void updateStatusLabels(void);
+
+    void userCapnoCallback(const CapnoSampleView &data, DeviceType device_type, uint8_t conn_handle, DataType data_type);
     void startBlockingFunction(void);
-    CapnoTrainer capnoTrainer;
 
     // some variables that should be part of struct.
 
-    // use to calculate the x-axis time point for each sample.
-    uint32_t co2Samples = 0;
+    // counts the samples for downsampling (the library may call back from
+    // more than one thread), the x-axis time points come with the data
+    // (see CapnoSampleView).
+    std::atomic<uint32_t> co2Samples{0};
     // increase this as if you want to keep more data on graph.
     // for 1 minute with 100 samples/seconds, you'll have
     // 6000 points.
     uint32_t co2DataDownsample = 1;
-    double co2Rate = 100.0; // sample rate is almost 100.
-
-    // this needs to be thread-safe (as shared resource).
+    double co2Rate = 100.0; // sample rate is almost 100 (nominal, for sizing).
+    double co2MaxTime = 60.0; // in seconds, shown on the graph.
+
+    // EtCO2, insp. CO2 and BPM measured on the raw CO2 samples, one detector
+    // per conn_handle (created with the first samples of the device, only
+    // touched by the thread that calls back for it).
+    std::array<std::unique_ptr<BreathDetector>, 256> co2Breaths;
+    // the device averages are shown again once no breath was measured for
+    // this many seconds (flat or noisy waveform).
+    double co2BreathsStaleAfter = 15.0;
+    // RMSSD, SDNN, pNN50 and LF/HF of the RR intervals, one analyzer per
+    // conn_handle (created with the first intervals of the device, only
+    // touched by the thread that calls back for it). Their results come back
+    // into the callback as DATA_HRV_*.
+    std::array<std::unique_ptr<HrvAnalyzer>, 256> hrv;
+
+    // lock-free hand over from the callback threads to the GUI thread.
     // you can make the similar one for HRV (rr-interval and hr)
     // or emgs 1 - 4 channels (see user_callback).
-    std::queue<std::vector<float>> co2Queue;
+    // 8192 samples is ~80 seconds of CO2 at 100 Hz.
+    SampleRingBuffer<TimedSample> co2Ring{8192};
+
+    // the sources of the callback come after everything it touches, so
+    // their threads are gone before any of it is destroyed.
+
+    // writes everything the callback gets to a file, see CAPNO_RECORD in
+    // the constructor.
+    SessionRecorder recorder;
+    CapnoTrainer capnoTrainer;
+    // feeds the callback without a dongle, see CAPNO_SIMULATE in the constructor.
+    std::unique_ptr<CapnoSimulator> simulator;
+    // plays a recorded session, see CAPNO_REPLAY in the constructor.
+    std::unique_ptr<SessionReplay> replay;
 
     // graph timer
     QTimer graphPlotTimer;
-    QMutex dataMutex;
-    int maxQueueSize = 100;
 
 
 private slots:
@@ -72,23 +132,4 @@ private slots:
 };
 
 
-
-class TimeAxisTicker : public QCPAxisTicker
-{
-public:
-    QString getTickLabel(double tick, const QLocale &locale, QChar formatChar, int precision) override
-    {
-        Q_UNUSED(locale)
-        Q_UNUSED(formatChar)
-        Q_UNUSED(precision)
-
-        int totalSeconds = static_cast<int>(tick);
-        int minutes = totalSeconds / 60;
-        int seconds = totalSeconds % 60;
-
-        return tick >= 0 ? QString("%1:%2").arg(minutes, 2, 10, QChar('0')).arg(seconds, 2, 10, QChar('0')) : QString("");
-    }
-};
-
-
 #endif // MAINWINDOW_H
@@ -24,6 +24,12 @@
 ****************************************************************************/
 
 #include "qcustomplot.h"
+#ifdef QCP_SIMD_SSE2
+#  include <emmintrin.h>
+#endif
+#ifdef QCP_SIMD_AVX2
+#  include <immintrin.h>
+#endif
 
 
 /* including file 'src/vector2d.cpp'       */
@@ -649,6 +655,26 @@ void QCPAbstractPaintBuffer::setDevicePixelRatio(double ratio)
   }
 }
 
+/*!
+  Shifts the contents of the buffer inside \a rect by \a dx pixels horizontally and \a dy pixels
+  vertically. The area of \a rect that is uncovered by the shift keeps undefined contents and must
+  be redrawn. \a rect, \a dx and \a dy are in logical pixels, i.e. device independent.
+
+  This is used by \ref QCPLayer instances with a scroll axis (\ref QCPLayer::setScrollAxis), to
+  only redraw the strip of the layer that was exposed by a shifted axis range.
+
+  Returns true if the contents were shifted. The default implementation doesn't support shifting
+  and returns false, in which case the layer is redrawn completely. Subclasses may reimplement
+  this method if their buffer type allows shifting its contents cheaply.
+*/
+bool QCPAbstractPaintBuffer::scroll(int dx, int dy, const QRect &rect)
+{
+  Q_UNUSED(dx)
+  Q_UNUSED(dy)
+  Q_UNUSED(rect)
+  return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCPPaintBufferPixmap
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -699,6 +725,20 @@ void QCPPaintBufferPixmap::clear(const QColor &color)
   mBuffer.fill(color);
 }
 
+/* inherits documentation from base class */
+bool QCPPaintBufferPixmap::scroll(int dx, int dy, const QRect &rect)
+{
+  // QPixmap::scroll works on device pixels, so the shift must stay integral after scaling:
+  const double deviceDx = dx*mDevicePixelRatio;
+  const double deviceDy = dy*mDevicePixelRatio;
+  if (!qFuzzyCompare(deviceDx+1, qRound(deviceDx)+1.0) || !qFuzzyCompare(deviceDy+1, qRound(deviceDy)+1.0))
+    return false;
+  const QRect deviceRect(qRound(rect.x()*mDevicePixelRatio), qRound(rect.y()*mDevicePixelRatio),
+                         qRound(rect.width()*mDevicePixelRatio), qRound(rect.height()*mDevicePixelRatio));
+  mBuffer.scroll(qRound(deviceDx), qRound(deviceDy), deviceRect);
+  return true;
+}
+
 /* inherits documentation from base class */
 void QCPPaintBufferPixmap::reallocateBuffer()
 {
@@ -719,6 +759,106 @@ void QCPPaintBufferPixmap::reallocateBuffer()
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPPaintBufferImage
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPPaintBufferImage
+  \brief A paint buffer based on QImage, using software raster rendering
+
+  This paint buffer uses software rendering and a QImage as internal buffer. Unlike QPixmap, a
+  QImage may be painted on outside the GUI thread, so this paint buffer is used instead of \ref
+  QCPPaintBufferPixmap if the plotting hint \ref QCP::phParallelLayers is set (and \ref
+  QCustomPlot::setOpenGl is false).
+*/
+
+/*!
+  Creates an image paint buffer instance with the specified \a size and \a devicePixelRatio, if
+  applicable.
+*/
+QCPPaintBufferImage::QCPPaintBufferImage(const QSize &size, double devicePixelRatio) :
+  QCPAbstractPaintBuffer(size, devicePixelRatio)
+{
+  QCPPaintBufferImage::reallocateBuffer();
+}
+
+QCPPaintBufferImage::~QCPPaintBufferImage()
+{
+}
+
+/* inherits documentation from base class */
+QCPPainter *QCPPaintBufferImage::startPainting()
+{
+  QCPPainter *result = new QCPPainter(&mBuffer);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  result->setRenderHint(QPainter::HighQualityAntialiasing);
+#endif
+  return result;
+}
+
+/* inherits documentation from base class */
+void QCPPaintBufferImage::draw(QCPPainter *painter) const
+{
+  if (painter && painter->isActive())
+    painter->drawImage(0, 0, mBuffer);
+  else
+    qDebug() << Q_FUNC_INFO << "invalid or inactive painter passed";
+}
+
+/* inherits documentation from base class */
+void QCPPaintBufferImage::clear(const QColor &color)
+{
+  mBuffer.fill(color);
+}
+
+/* inherits documentation from base class */
+bool QCPPaintBufferImage::scroll(int dx, int dy, const QRect &rect)
+{
+  const double deviceDx = dx*mDevicePixelRatio;
+  const double deviceDy = dy*mDevicePixelRatio;
+  if (!qFuzzyCompare(deviceDx+1, qRound(deviceDx)+1.0) || !qFuzzyCompare(deviceDy+1, qRound(deviceDy)+1.0))
+    return false;
+  const QPoint delta(qRound(deviceDx), qRound(deviceDy));
+  const QRect deviceRect = QRect(qRound(rect.x()*mDevicePixelRatio), qRound(rect.y()*mDevicePixelRatio),
+                                 qRound(rect.width()*mDevicePixelRatio), qRound(rect.height()*mDevicePixelRatio)) & mBuffer.rect();
+  const QRect sourceRect = deviceRect.translated(-delta) & deviceRect; // part of the rect that stays inside after the shift
+  if (sourceRect.isEmpty())
+    return true;
+  
+  // move the rows in an order that never overwrites rows which are still to be moved:
+  const int bytesPerPixel = mBuffer.depth()/8;
+  const int rowBytes = sourceRect.width()*bytesPerPixel;
+  const int firstRow = delta.y() > 0 ? sourceRect.bottom() : sourceRect.top();
+  const int rowStep = delta.y() > 0 ? -1 : 1;
+  for (int i=0; i<sourceRect.height(); ++i)
+  {
+    const int row = firstRow+i*rowStep;
+    memmove(mBuffer.scanLine(row+delta.y())+(sourceRect.left()+delta.x())*bytesPerPixel,
+            mBuffer.constScanLine(row)+sourceRect.left()*bytesPerPixel, size_t(rowBytes));
+  }
+  return true;
+}
+
+/* inherits documentation from base class */
+void QCPPaintBufferImage::reallocateBuffer()
+{
+  setInvalidated();
+  if (!qFuzzyCompare(1.0, mDevicePixelRatio))
+  {
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+    mBuffer = QImage(mSize*mDevicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+    mBuffer.setDevicePixelRatio(mDevicePixelRatio);
+#else
+    qDebug() << Q_FUNC_INFO << "Device pixel ratios not supported for Qt versions before 5.4";
+    mDevicePixelRatio = 1.0;
+    mBuffer = QImage(mSize, QImage::Format_ARGB32_Premultiplied);
+#endif
+  } else
+  {
+    mBuffer = QImage(mSize, QImage::Format_ARGB32_Premultiplied);
+  }
+}
+
 
 #ifdef QCP_OPENGL_PBUFFER
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1036,6 +1176,22 @@ void QCPPaintBufferGlFbo::reallocateBuffer()
   compared with a full replot of all layers. Upon creation of a new layer, the layer mode is
   initialized to \ref lmLogical. The only layer that is set to \ref lmBuffered in a new \ref
   QCustomPlot instance is the "overlay" layer, containing the selection rect.
+
+  \section qcplayer-scrolling Scrolling layers
+
+  For plots that continuously append data and move the key axis range along with it (e.g. a strip
+  chart of a live signal), a buffered layer can be given a scroll axis with \ref setScrollAxis. If
+  between two replots only the range of that axis was shifted by an integral number of pixels and
+  data was appended, the paint buffer of the layer is shifted and only the exposed strip and the
+  area behind the previously last data point are redrawn, instead of the whole layer. All other
+  layers are replotted as usual.
+
+  \section qcplayer-axiscache Caching axes
+
+  Axes are comparatively expensive to draw (tick labels), but in many plots most of them don't
+  change between replots. A buffered layer that only contains axes and grids can keep its paint
+  buffer from the last replot with \ref setAxisCache, as long as the geometry, ranges, tick
+  vectors and labels of these axes are unchanged.
 */
 
 /* start documentation of inline functions */
@@ -1070,7 +1226,15 @@ QCPLayer::QCPLayer(QCustomPlot *parentPlot, const QString &layerName) :
   mName(layerName),
   mIndex(-1), // will be set to a proper value by the QCustomPlot layer creation function
   mVisible(true),
-  mMode(lmLogical)
+  mMode(lmLogical),
+  mAxisCache(false),
+  mScrollStateValid(false),
+  mScrollPending(false),
+  mScrollRangeReversed(false),
+  mScrollDataEdge(qQNaN()),
+  mScrollMargin(1),
+  mCacheStateValid(false),
+  mCachePending(false)
 {
   // Note: no need to make sure layerName is unique, because layer
   // management is done with QCustomPlot functions.
@@ -1134,20 +1298,100 @@ void QCPLayer::setMode(QCPLayer::LayerMode mode)
   }
 }
 
+/*!
+  Returns the scroll axis of this layer, or \c nullptr if the layer is always replotted completely.
+
+  \see setScrollAxis
+*/
+QCPAxis *QCPLayer::scrollAxis() const
+{
+  return mScrollAxis.data();
+}
+
+/*!
+  Sets the axis whose range shifts are turned into shifts of the paint buffer of this layer, instead
+  of complete redraws.
+
+  When the parent plot is replotted and, since the last replot, the range of \a axis was only moved
+  by an integral number of pixels (its size, scale type and axis rect geometry as well as the ranges
+  of all other axes in the same axis rect are unchanged), the buffer contents inside the axis rect
+  are shifted accordingly. Then only the strip that was exposed by the shift and the area behind the
+  previously last data point of the plottables with \a axis as key axis are redrawn. So to benefit
+  from scrolling, the range of \a axis should be moved in steps of whole pixels.
+
+  This requires the layer to be in mode \ref lmBuffered (see \ref setMode) and a paint buffer that
+  supports shifting (\ref QCPAbstractPaintBuffer::scroll), i.e. the software rendering paint
+  buffer. Otherwise, and whenever one of the conditions above isn't met, the layer is replotted
+  completely.
+
+  Scrolling assumes that the layerables on this layer only draw inside the axis rect of \a axis and
+  that their data only changes by appending data points with higher keys (removing data points that
+  are outside the visible range is fine as well). Changes of the appearance, like pens or scatter
+  styles, aren't detected. Calling this method again (even with the same axis) discards the state of
+  the last replot, so the next replot of this layer draws it completely.
+
+  Set \a axis to \c nullptr to disable scrolling.
+
+  \see QCustomPlot::replot
+*/
+void QCPLayer::setScrollAxis(QCPAxis *axis)
+{
+  mScrollAxis = axis;
+  mScrollStateValid = false;
+  mScrollPending = false;
+}
+
+/*!
+  Sets whether the paint buffer of this layer is kept from one replot of the parent plot to the
+  next, as long as the axes on this layer are unchanged.
+
+  This is meant for a layer that holds axes (\ref QCPAxis) and grids (\ref QCPGrid) whose ranges
+  rarely change, while other parts of the plot are replotted continuously. At every replot, the
+  size of the paint buffer, the visibility, axis rect geometry, offset, range, scale type, selected
+  parts, tick and sub tick coordinates, tick labels and label of each axis (for grids, of their
+  parent axis) are compared to the state at the last drawing. Only if one of them changed, the
+  layer is redrawn. Axes whose ticks move with every replot, like the key axis of a scrolling
+  strip chart, should therefore be placed on a different layer.
+
+  This requires the layer to be in mode \ref lmBuffered (see \ref setMode) and to contain nothing
+  but axes and grids. Otherwise the layer is replotted completely, as without caching. Changes of
+  the appearance, like pens, fonts or colors, aren't detected. Calling this method again (even with
+  the same value) discards the cached state, so the next replot draws the layer completely, as does
+  \ref replot of this layer.
+
+  \see setScrollAxis
+*/
+void QCPLayer::setAxisCache(bool enabled)
+{
+  mAxisCache = enabled;
+  mCacheStateValid = false;
+  mCachePending = false;
+}
+
 /*! \internal
 
   Draws the contents of this layer with the provided \a painter.
 
+  If \a exposedRect is valid, the drawing is restricted to it. This is used when the paint buffer
+  was shifted because of a scrolled axis range (see \ref setScrollAxis).
+
   \see replot, drawToPaintBuffer
 */
-void QCPLayer::draw(QCPPainter *painter)
+void QCPLayer::draw(QCPPainter *painter, const QRect &exposedRect)
 {
   foreach (QCPLayerable *child, mChildren)
   {
     if (child->realVisibility())
     {
+      QRect clipRect = child->clipRect().translated(0, -1);
+      if (exposedRect.isValid())
+      {
+        clipRect &= exposedRect;
+        if (clipRect.isEmpty())
+          continue;
+      }
       painter->save();
-      painter->setClipRect(child->clipRect().translated(0, -1));
+      painter->setClipRect(clipRect);
       child->applyDefaultAntialiasingHint(painter);
       child->draw(painter);
       painter->restore();
@@ -1167,20 +1411,248 @@ void QCPLayer::drawToPaintBuffer()
 {
   if (QSharedPointer<QCPAbstractPaintBuffer> pb = mPaintBuffer.toStrongRef())
   {
-    if (QCPPainter *painter = pb->startPainting())
+    // if prepared by the parent plot, the buffer still holds the unchanged axes of the last drawing:
+    if (mCachePending)
     {
-      if (painter->isActive())
-        draw(painter);
-      else
-        qDebug() << Q_FUNC_INFO << "paint buffer returned inactive painter";
-      delete painter;
-      pb->donePainting();
-    } else
-      qDebug() << Q_FUNC_INFO << "paint buffer returned nullptr painter";
+      mCachePending = false;
+      return;
+    }
+    
+    // if prepared by the parent plot, shift the previous buffer contents and only draw the exposed part:
+    bool scrolled = false;
+    if (mScrollPending)
+    {
+      mScrollPending = false;
+      scrolled = mScrollDelta.isNull() || pb->scroll(mScrollDelta.x(), mScrollDelta.y(), mScrollAxisRect.translated(0, -1));
+      if (!scrolled)
+        pb->clear(Qt::transparent); // buffer didn't keep its contents for us, so fall back to drawing everything
+    }
+    
+    if (!scrolled || !mScrollExposedRect.isEmpty())
+    {
+      if (QCPPainter *painter = pb->startPainting())
+      {
+        if (painter->isActive())
+        {
+          if (scrolled)
+          {
+            painter->setCompositionMode(QPainter::CompositionMode_Source);
+            painter->fillRect(mScrollExposedRect, Qt::transparent);
+            painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+            draw(painter, mScrollExposedRect);
+          } else
+            draw(painter);
+        } else
+          qDebug() << Q_FUNC_INFO << "paint buffer returned inactive painter";
+        delete painter;
+        pb->donePainting();
+      } else
+        qDebug() << Q_FUNC_INFO << "paint buffer returned nullptr painter";
+    }
+    updateScrollState();
+    updateCacheState();
   } else
     qDebug() << Q_FUNC_INFO << "no valid paint buffer associated with this layer";
 }
 
+/*! \internal
+
+  Checks whether the paint buffer of this layer can be shifted instead of redrawn at the next call
+  of \ref drawToPaintBuffer, by comparing the scroll axis (\ref setScrollAxis) and its axis rect to
+  the state recorded at the last drawing. If so, the shift and the rect that must be redrawn are
+  stored and true is returned. The parent plot then keeps the buffer contents instead of clearing
+  them.
+
+  This is called by \ref QCustomPlot::setupPaintBuffers after the layout was updated.
+*/
+bool QCPLayer::prepareScroll()
+{
+  mScrollPending = false;
+  QCPAxis *axis = mScrollAxis.data();
+  if (mMode != lmBuffered || !mScrollStateValid || !axis || !axis->axisRect() || axis->scaleType() != QCPAxis::stLinear)
+    return false;
+  QSharedPointer<QCPAbstractPaintBuffer> pb = mPaintBuffer.toStrongRef();
+  if (!pb || pb->invalidated())
+    return false;
+  
+  // the mapping must only differ in an offset along the scroll axis:
+  QCPAxisRect *axisRect = axis->axisRect();
+  const QList<QCPAxis*> axes = axisRect->axes();
+  if (axisRect->rect() != mScrollAxisRect || axis->rangeReversed() != mScrollRangeReversed || mScrollRanges.size() != axes.size()*2 ||
+      !qFuzzyCompare(axis->range().size(), mScrollRanges.at(1)-mScrollRanges.at(0)))
+    return false;
+  int rangeIndex = 2;
+  foreach (QCPAxis *otherAxis, axes)
+  {
+    if (otherAxis == axis)
+      continue;
+    if (otherAxis->range().lower != mScrollRanges.at(rangeIndex) || otherAxis->range().upper != mScrollRanges.at(rangeIndex+1))
+      return false;
+    rangeIndex += 2;
+  }
+  const double shift = axis->coordToPixel(mScrollRanges.at(0))-axis->coordToPixel(axis->range().lower);
+  const int pixelShift = qRound(shift);
+  if (qAbs(shift-pixelShift) > 0.01)
+    return false;
+  
+  // determine the pixel interval along the axis that needs to be redrawn:
+  const QRect scrollRect = mScrollAxisRect.translated(0, -1); // same as the clip rect of the layerables, see draw
+  const bool horizontal = axis->orientation() == Qt::Horizontal;
+  const int rectBegin = horizontal ? scrollRect.left() : scrollRect.top();
+  const int rectEnd = rectBegin + (horizontal ? scrollRect.width() : scrollRect.height());
+  if (qAbs(pixelShift) >= rectEnd-rectBegin)
+    return false;
+  int exposedBegin = rectEnd;
+  int exposedEnd = rectBegin;
+  if (pixelShift < 0) // contents moved towards lower pixels, strip at the end is exposed
+  {
+    exposedBegin = rectEnd+pixelShift;
+    exposedEnd = rectEnd;
+  } else if (pixelShift > 0)
+  {
+    exposedBegin = rectBegin;
+    exposedEnd = rectBegin+pixelShift;
+  }
+  if (!qIsNaN(mScrollDataEdge)) // appended data points (and the segment to the previously last one) lie behind the old data edge
+  {
+    const double edgePixel = axis->coordToPixel(mScrollDataEdge);
+    if (axis->pixelOrientation() > 0)
+    {
+      exposedBegin = qMin(exposedBegin, qFloor(edgePixel)-mScrollMargin);
+      exposedEnd = rectEnd;
+    } else
+    {
+      exposedBegin = rectBegin;
+      exposedEnd = qMax(exposedEnd, qCeil(edgePixel)+mScrollMargin);
+    }
+  }
+  exposedBegin = qBound(rectBegin, exposedBegin, rectEnd);
+  exposedEnd = qBound(rectBegin, exposedEnd, rectEnd);
+  if (exposedEnd-exposedBegin >= rectEnd-rectBegin) // everything exposed, nothing gained by shifting
+    return false;
+  
+  mScrollDelta = horizontal ? QPoint(pixelShift, 0) : QPoint(0, pixelShift);
+  if (exposedEnd <= exposedBegin)
+    mScrollExposedRect = QRect();
+  else if (horizontal)
+    mScrollExposedRect = QRect(exposedBegin, scrollRect.top(), exposedEnd-exposedBegin, scrollRect.height());
+  else
+    mScrollExposedRect = QRect(scrollRect.left(), exposedBegin, scrollRect.width(), exposedEnd-exposedBegin);
+  mScrollPending = true;
+  return true;
+}
+
+/*! \internal
+
+  Records the state of the scroll axis (\ref setScrollAxis), its axis rect and the plottables on
+  this layer after the layer was drawn, so \ref prepareScroll can decide at the next replot whether
+  the buffer contents may be shifted.
+*/
+void QCPLayer::updateScrollState()
+{
+  mScrollStateValid = false;
+  QCPAxis *axis = mScrollAxis.data();
+  if (!axis || !axis->axisRect())
+    return;
+  
+  QCPAxisRect *axisRect = axis->axisRect();
+  mScrollAxisRect = axisRect->rect();
+  mScrollRangeReversed = axis->rangeReversed();
+  mScrollRanges.clear();
+  mScrollRanges << axis->range().lower << axis->range().upper;
+  foreach (QCPAxis *otherAxis, axisRect->axes())
+  {
+    if (otherAxis != axis)
+      mScrollRanges << otherAxis->range().lower << otherAxis->range().upper;
+  }
+  
+  // find the highest key of the plottables that scroll along, and how far their drawing may extend beyond a data point:
+  mScrollDataEdge = qQNaN();
+  mScrollMargin = 1;
+  foreach (QCPLayerable *child, mChildren)
+  {
+    QCPAbstractPlottable *plottable = qobject_cast<QCPAbstractPlottable*>(child);
+    if (!plottable || plottable->keyAxis() != axis || !plottable->realVisibility())
+      continue;
+    bool foundRange;
+    const QCPRange keyRange = plottable->getKeyRange(foundRange);
+    if (foundRange && (qIsNaN(mScrollDataEdge) || keyRange.upper > mScrollDataEdge))
+      mScrollDataEdge = keyRange.upper;
+    double extent = plottable->pen().widthF();
+    if (QCPGraph *graph = qobject_cast<QCPGraph*>(plottable))
+      extent = qMax(extent, graph->scatterStyle().size());
+    mScrollMargin = qMax(mScrollMargin, qCeil(extent)+1); // one more pixel for antialiasing
+  }
+  mScrollStateValid = true;
+}
+
+/*! \internal
+
+  Checks whether the paint buffer of this layer still holds what \ref drawToPaintBuffer would draw,
+  because the axes on this layer are unchanged since the last drawing (see \ref setAxisCache). If
+  so, true is returned and the parent plot keeps the buffer contents instead of clearing them, and
+  the next call of \ref drawToPaintBuffer doesn't draw anything.
+
+  This is called by \ref QCustomPlot::setupPaintBuffers after the layout was updated, so the tick
+  vectors and labels of the axes are up to date.
+*/
+bool QCPLayer::prepareCache()
+{
+  mCachePending = false;
+  if (!mAxisCache || mMode != lmBuffered || !mCacheStateValid)
+    return false;
+  QSharedPointer<QCPAbstractPaintBuffer> pb = mPaintBuffer.toStrongRef();
+  if (!pb || pb->invalidated())
+    return false;
+  
+  QVector<double> state;
+  QVector<QString> labels;
+  if (!getCacheState(state, labels) || state != mCacheState || labels != mCacheLabels)
+    return false;
+  mCachePending = true;
+  return true;
+}
+
+/*! \internal
+
+  Records the state of the axes on this layer after the layer was drawn, so \ref prepareCache can
+  decide at the next replot whether the buffer contents may be kept.
+*/
+void QCPLayer::updateCacheState()
+{
+  mCacheStateValid = mAxisCache && getCacheState(mCacheState, mCacheLabels);
+}
+
+/*! \internal
+
+  Collects everything that determines the drawing of the axes and grids on this layer into \a
+  state and \a labels, see \ref setAxisCache. Returns false if the layer holds other layerables,
+  whose changes can't be detected.
+*/
+bool QCPLayer::getCacheState(QVector<double> &state, QVector<QString> &labels) const
+{
+  state.clear();
+  labels.clear();
+  if (QSharedPointer<QCPAbstractPaintBuffer> pb = mPaintBuffer.toStrongRef())
+    state << pb->size().width() << pb->size().height() << pb->devicePixelRatio();
+  foreach (QCPLayerable *child, mChildren)
+  {
+    QCPAxis *axis = qobject_cast<QCPAxis*>(child);
+    if (QCPGrid *grid = qobject_cast<QCPGrid*>(child))
+      axis = grid->mParentAxis;
+    if (!axis || !axis->axisRect())
+      return false;
+    
+    const QRect axisRect = axis->axisRect()->rect();
+    state << child->realVisibility() << axisRect.left() << axisRect.top() << axisRect.width() << axisRect.height()
+          << axis->offset() << axis->range().lower << axis->range().upper << axis->rangeReversed() << axis->scaleType()
+          << int(axis->selectedParts()) << axis->mTickVector.size() << axis->mSubTickVector.size();
+    state << axis->mTickVector << axis->mSubTickVector;
+    labels << axis->mLabel << axis->mTickVectorLabels;
+  }
+  return true;
+}
+
 /*!
   If the layer mode (\ref setMode) is set to \ref lmBuffered, this method allows replotting only
   the layerables on this specific layer, without the need to replot all other layers (as a call to
@@ -1202,6 +1674,8 @@ void QCPLayer::replot()
     if (QSharedPointer<QCPAbstractPaintBuffer> pb = mPaintBuffer.toStrongRef())
     {
       pb->clear(Qt::transparent);
+      mScrollPending = false;
+      mCachePending = false;
       drawToPaintBuffer();
       pb->setInvalidated(false); // since layer is lmBuffered, we know only this layer is on buffer and we can reset invalidated flag
       mParentPlot->update();
@@ -9349,6 +9823,118 @@ double QCPAxis::coordToPixel(double value) const
   }
 }
 
+/*!
+  Transforms \a count values from pixel coordinates of the QCustomPlot widget (\a pixels) to
+  coordinates of the axis (\a coords). This gives the same results as calling \ref pixelToCoord for
+  each value, but the scale type, orientation and range reversal are only evaluated once, leaving a
+  branch-free inner loop.
+
+  \a pixels and \a coords may point to the same array.
+
+  \see coordsToPixels
+*/
+void QCPAxis::pixelsToCoords(const double *pixels, double *coords, int count) const
+{
+  double pixelOrigin, scale, invalidPixel;
+  getPixelMapping(pixelOrigin, scale, invalidPixel);
+  if (mScaleType == stLinear)
+  {
+    const double coordOrigin = mRange.lower;
+    for (int i=0; i<count; ++i)
+      coords[i] = (pixels[i]-pixelOrigin)/scale+coordOrigin;
+  } else // mScaleType == stLogarithmic
+  {
+    for (int i=0; i<count; ++i)
+      coords[i] = qExp((pixels[i]-pixelOrigin)/scale)*mRange.lower;
+  }
+}
+
+/*!
+  Transforms \a count values from coordinates of the axis (\a coords) to pixel coordinates of the
+  QCustomPlot widget (\a pixels). This gives the same results as calling \ref coordToPixel for each
+  value, but the scale type, orientation and range reversal are only evaluated once, leaving a
+  branch-free inner loop that is vectorized for linear axes.
+
+  \a coords and \a pixels may point to the same array.
+
+  \see pixelsToCoords
+*/
+void QCPAxis::coordsToPixels(const double *coords, double *pixels, int count) const
+{
+  double pixelOrigin, scale, invalidPixel;
+  getPixelMapping(pixelOrigin, scale, invalidPixel);
+  if (mScaleType == stLinear)
+  {
+    const double coordOrigin = mRange.lower;
+    int i = 0;
+#ifdef QCP_SIMD_SSE2
+    const __m128d coordOrigin2 = _mm_set1_pd(coordOrigin);
+    const __m128d scale2 = _mm_set1_pd(scale);
+    const __m128d pixelOrigin2 = _mm_set1_pd(pixelOrigin);
+    for (; i+1<count; i+=2)
+      _mm_storeu_pd(pixels+i, _mm_add_pd(_mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(coords+i), coordOrigin2), scale2), pixelOrigin2));
+#endif
+    for (; i<count; ++i)
+      pixels[i] = (coords[i]-coordOrigin)*scale+pixelOrigin;
+  } else // mScaleType == stLogarithmic
+  {
+    const bool negativeRange = mRange.upper < 0;
+    for (int i=0; i<count; ++i)
+    {
+      if (negativeRange ? coords[i] >= 0.0 : coords[i] <= 0.0) // invalid value for logarithmic scale, draw it outside visible range like coordToPixel
+        pixels[i] = invalidPixel;
+      else
+        pixels[i] = qLn(coords[i]/mRange.lower)*scale+pixelOrigin;
+    }
+  }
+}
+
+/*! \overload
+
+  Transforms \a count values from coordinates of the axis to pixel coordinates, reading them from
+  \a coords with a stride of \a coordStride doubles, and writing them to the coordinate of \a pixels
+  that corresponds to the orientation of this axis (x for horizontal, y for vertical axes). The
+  other coordinate of \a pixels stays untouched.
+
+  This allows plottables to convert the keys or values of their data points directly to pixel
+  points, e.g. for \ref QCPGraphData with <tt>coordsToPixels(&data.first().key, 2, points, count)</tt>.
+*/
+void QCPAxis::coordsToPixels(const double *coords, int coordStride, QPointF *pixels, int count) const
+{
+  double pixelOrigin, scale, invalidPixel;
+  getPixelMapping(pixelOrigin, scale, invalidPixel);
+  const bool horizontal = orientation() == Qt::Horizontal;
+  if (mScaleType == stLinear)
+  {
+    const double coordOrigin = mRange.lower;
+    if (horizontal)
+    {
+      for (int i=0; i<count; ++i)
+        pixels[i].rx() = (coords[i*coordStride]-coordOrigin)*scale+pixelOrigin;
+    } else
+    {
+      for (int i=0; i<count; ++i)
+        pixels[i].ry() = (coords[i*coordStride]-coordOrigin)*scale+pixelOrigin;
+    }
+  } else // mScaleType == stLogarithmic
+  {
+    const bool negativeRange = mRange.upper < 0;
+    for (int i=0; i<count; ++i)
+    {
+      const double coord = coords[i*coordStride];
+      double pixel;
+      if (negativeRange ? coord >= 0.0 : coord <= 0.0) // invalid value for logarithmic scale, draw it outside visible range like coordToPixel
+        pixel = invalidPixel;
+      else
+        pixel = qLn(coord/mRange.lower)*scale+pixelOrigin;
+      if (horizontal)
+        pixels[i].rx() = pixel;
+      else
+        pixels[i].ry() = pixel;
+    }
+  }
+}
+
 /*!
   Returns the part of the axis that is hit by \a pos (in pixels). The return value of this function
   is independent of the user-selectable parts defined with \ref setSelectableParts. Further, this
@@ -9743,10 +10329,34 @@ void QCPAxis::setupTickVectors()
 
 /*! \internal
   
-  Returns the pen that is used to draw the axis base line. Depending on the selection state, this
-  is either mSelectedBasePen or mBasePen.
+  Returns the coefficients of the transformation from axis coordinates to pixels, with scale type,
+  orientation and range reversal already resolved, for the batched transformations \ref
+  coordsToPixels and \ref pixelsToCoords:
+
+  For linear axes, <tt>pixel = (coord-range().lower)*scale+pixelOrigin</tt>. For logarithmic
+  axes, <tt>pixel = ln(coord/range().lower)*scale+pixelOrigin</tt>, and \a invalidPixel is the
+  pixel that \ref coordToPixel returns for values of the wrong sign.
 */
-QPen QCPAxis::getBasePen() const
+void QCPAxis::getPixelMapping(double &pixelOrigin, double &scale, double &invalidPixel) const
+{
+  pixelOrigin = coordToPixel(mRange.lower);
+  if (mScaleType == stLinear)
+  {
+    scale = (coordToPixel(mRange.upper)-pixelOrigin)/mRange.size();
+    invalidPixel = 0;
+  } else // mScaleType == stLogarithmic
+  {
+    scale = (coordToPixel(mRange.upper)-pixelOrigin)/qLn(mRange.upper/mRange.lower);
+    invalidPixel = coordToPixel(0.0); // zero is an invalid value in both sign domains
+  }
+}
+
+/*! \internal
+  
+  Returns the pen that is used to draw the axis base line. Depending on the selection state, this
+  is either mSelectedBasePen or mBasePen.
+*/
+QPen QCPAxis::getBasePen() const
 {
   return mSelectedParts.testFlag(spAxis) ? mSelectedBasePen : mBasePen;
 }
@@ -13296,6 +13906,15 @@ QCP::Interaction QCPAbstractItem::selectionCategory() const
   one cell with the main QCPAxisRect inside.
 */
 
+/*! \fn QThreadPool *QCustomPlot::threadPool() const
+  
+  Returns the thread pool this QCustomPlot instance draws its buffered layers on when \ref
+  QCP::phParallelLayers is set, and that \ref QCPColorMap splits large updates over. It is owned by
+  the plot and separate from QThreadPool::globalInstance, so tasks the application runs on the
+  global pool can't hold up a replot, and vice versa. Its maximum thread count may be changed, by
+  default it is the number of CPU cores.
+*/
+
 /* end of documentation of inline functions */
 /* start of documentation of signals */
 
@@ -13625,6 +14244,7 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
   mReplotQueued(false),
   mReplotTime(0),
   mReplotTimeAverage(0),
+  mThreadPool(new QThreadPool(this)),
   mOpenGlMultisamples(16),
   mOpenGlAntialiasedElementsBackup(QCP::aeNone),
   mOpenGlCacheLabelsBackup(true)
@@ -13919,11 +14539,26 @@ void QCustomPlot::setNoAntialiasingOnDrag(bool enabled)
 /*!
   Sets the plotting hints for this QCustomPlot instance as an \a or combination of QCP::PlottingHint.
   
+  If \ref QCP::phParallelLayers is set, each layer in mode \ref QCPLayer::lmBuffered is drawn into
+  its own paint buffer on a thread of \ref threadPool during \ref replot, while the other
+  layers are drawn on the GUI thread. The buffers are joined on the GUI thread as usual. The paint
+  buffers are QImage based (\ref QCPPaintBufferImage) in this mode. Layerables on buffered layers
+  must then not touch state shared with layerables on other layers while drawing, and must not
+  draw QPixmaps (e.g. \ref QCPItemPixmap or scatter styles with a pixmap). Typically, each buffered
+  layer holds the plottables of one independent signal.
+  
   \see setPlottingHint
 */
 void QCustomPlot::setPlottingHints(const QCP::PlottingHints &hints)
 {
+  const bool parallelChanged = hints.testFlag(QCP::phParallelLayers) != mPlottingHints.testFlag(QCP::phParallelLayers);
   mPlottingHints = hints;
+  if (parallelChanged && !mOpenGl)
+  {
+    // recreate all paint buffers with the type suitable for the new mode:
+    mPaintBuffers.clear();
+    setupPaintBuffers();
+  }
 }
 
 /*!
@@ -15088,6 +15723,32 @@ void QCustomPlot::deselectAll()
   }
 }
 
+/*! \internal
+
+  \brief Draws one buffered layer into its paint buffer on a thread of a QThreadPool
+
+  Used by \ref QCustomPlot::drawLayersToPaintBuffers if the plotting hint \ref
+  QCP::phParallelLayers is set. \a done is released once the layer was drawn.
+*/
+class QCPLayerRasterTask : public QRunnable
+{
+public:
+  QCPLayerRasterTask(QCPLayer *layer, QSemaphore *done) :
+    mLayer(layer),
+    mDone(done)
+  {}
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    mLayer->drawToPaintBuffer();
+    mDone->release();
+  }
+  
+private:
+  QCPLayer *mLayer;
+  QSemaphore *mDone;
+};
+
 /*!
   Causes a complete replot into the internal paint buffer(s). Finally, the widget surface is
   refreshed with the new buffer contents. This is the method that must be called to make changes to
@@ -15113,6 +15774,9 @@ void QCustomPlot::deselectAll()
   replot only that specific layer via \ref QCPLayer::replot. See the documentation there for
   details.
   
+  Buffered layers with a scroll axis (\ref QCPLayer::setScrollAxis) only redraw the part that was
+  exposed by shifting the axis range, if possible.
+  
   \see replotTime
 */
 void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
@@ -15144,8 +15808,7 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
   updateLayout();
   // draw all layered objects (grid, axes, plottables, items, legend,...) into their buffers:
   setupPaintBuffers();
-  foreach (QCPLayer *layer, mLayers)
-    layer->drawToPaintBuffer();
+  drawLayersToPaintBuffers();
   foreach (QSharedPointer<QCPAbstractPaintBuffer> buffer, mPaintBuffers)
     buffer->setInvalidated(false);
   
@@ -15830,7 +16493,9 @@ void QCustomPlot::drawBackground(QCPPainter *painter)
   This method uses \ref createPaintBuffer to create new paint buffers.
 
   After this method, the paint buffers are empty (filled with \c Qt::transparent) and invalidated
-  (so an attempt to replot only a single buffered layer causes a full replot).
+  (so an attempt to replot only a single buffered layer causes a full replot). The exception are
+  buffers of layers with a scroll axis whose previous contents can be shifted (see \ref
+  QCPLayer::setScrollAxis), they keep their contents until the layer is drawn.
 
   This method is called in every \ref replot call, prior to actually drawing the layers (into their
   associated paint buffer). If the paint buffers don't need changing/reallocating, this method
@@ -15853,6 +16518,11 @@ void QCustomPlot::setupPaintBuffers()
       ++bufferIndex;
       if (bufferIndex >= mPaintBuffers.size())
         mPaintBuffers.append(QSharedPointer<QCPAbstractPaintBuffer>(createPaintBuffer()));
+      if (layer->mPaintBuffer.toStrongRef() != mPaintBuffers.at(bufferIndex)) // layer moved to another buffer, its previous contents can't be scrolled or kept
+      {
+        layer->mScrollStateValid = false;
+        layer->mCacheStateValid = false;
+      }
       layer->mPaintBuffer = mPaintBuffers.at(bufferIndex).toWeakRef();
       if (layerIndex < mLayers.size()-1 && mLayers.at(layerIndex+1)->mode() == QCPLayer::lmLogical) // not last layer, and next one is logical, so prepare another buffer for next layerables
       {
@@ -15865,13 +16535,61 @@ void QCustomPlot::setupPaintBuffers()
   // remove unneeded buffers:
   while (mPaintBuffers.size()-1 > bufferIndex)
     mPaintBuffers.removeLast();
-  // resize buffers to viewport size and clear contents:
+  // resize buffers to viewport size:
   foreach (QSharedPointer<QCPAbstractPaintBuffer> buffer, mPaintBuffers)
-  {
     buffer->setSize(viewport().size()); // won't do anything if already correct size
-    buffer->clear(Qt::transparent);
-    buffer->setInvalidated();
+  // buffers of layers that only need to shift their previous contents or have unchanged axes keep them, all others are cleared:
+  QList<QCPAbstractPaintBuffer*> keptBuffers;
+  foreach (QCPLayer *layer, mLayers)
+  {
+    if (layer->prepareCache() || layer->prepareScroll())
+      keptBuffers.append(layer->mPaintBuffer.toStrongRef().data());
+  }
+  foreach (QSharedPointer<QCPAbstractPaintBuffer> buffer, mPaintBuffers)
+  {
+    if (!keptBuffers.contains(buffer.data()))
+    {
+      buffer->clear(Qt::transparent);
+      buffer->setInvalidated();
+    }
+  }
+}
+
+/*! \internal
+
+  Draws all layers into their associated paint buffers (see \ref setupPaintBuffers).
+
+  If the plotting hint \ref QCP::phParallelLayers is set, the layers in mode \ref
+  QCPLayer::lmBuffered are drawn in parallel on \ref threadPool, while the remaining layers
+  are drawn on the calling thread. This method returns when all layers are drawn.
+
+  \see replot
+*/
+void QCustomPlot::drawLayersToPaintBuffers()
+{
+  if (mOpenGl || !mPlottingHints.testFlag(QCP::phParallelLayers))
+  {
+    foreach (QCPLayer *layer, mLayers)
+      layer->drawToPaintBuffer();
+    return;
   }
+  
+  QSemaphore layersDone;
+  int layerTasks = 0;
+  QList<QCPLayer*> localLayers;
+  foreach (QCPLayer *layer, mLayers)
+  {
+    if (layer->mode() == QCPLayer::lmBuffered) // layer has its own paint buffer, so it can be drawn independently
+    {
+      mThreadPool->start(new QCPLayerRasterTask(layer, &layersDone));
+      ++layerTasks;
+    } else
+      localLayers.append(layer);
+  }
+  // logical layers share paint buffers with their neighbours, draw them here in their order while the tasks run:
+  foreach (QCPLayer *layer, localLayers)
+    layer->drawToPaintBuffer();
+  layersDone.acquire(layerTasks);
 }
 
 /*! \internal
@@ -15894,7 +16612,9 @@ QCPAbstractPaintBuffer *QCustomPlot::createPaintBuffer()
     qDebug() << Q_FUNC_INFO << "OpenGL enabled even though no support for it compiled in, this shouldn't have happened. Falling back to pixmap paint buffer.";
     return new QCPPaintBufferPixmap(viewport().size(), mBufferDevicePixelRatio);
 #endif
-  } else
+  } else if (mPlottingHints.testFlag(QCP::phParallelLayers))
+    return new QCPPaintBufferImage(viewport().size(), mBufferDevicePixelRatio);
+  else
     return new QCPPaintBufferPixmap(viewport().size(), mBufferDevicePixelRatio);
 }
 
@@ -16388,7 +17108,7 @@ QList<QCPLayerable*> QCustomPlot::layerableListAt(const QPointF &pos, bool onlyS
 */
 bool QCustomPlot::saveRastered(const QString &fileName, int width, int height, double scale, const char *format, int quality, int resolution, QCP::ResolutionUnit resolutionUnit)
 {
-  QImage buffer = toPixmap(width, height, scale).toImage();
+  QImage buffer = toImage(width, height, scale);
   
   int dotsPerMeter = 0;
   switch (resolutionUnit)
@@ -16457,6 +17177,63 @@ QPixmap QCustomPlot::toPixmap(int width, int height, double scale)
   return result;
 }
 
+/*!
+  Renders the plot to an image and returns it.
+  
+  The plot is sized to \a width and \a height in pixels and scaled with \a scale. (width 100 and
+  scale 2.0 lead to a full resolution image with width 200.)
+  
+  Other than \ref toPixmap, this doesn't involve any platform pixmaps. So it also works with the
+  "offscreen" platform plugin, e.g. for generating reports without a display, and the returned image
+  may be handed to other threads, e.g. to encode and save it in parallel to rendering the next plot.
+  The rendering itself must still happen in the thread of the QCustomPlot.
+  
+  \see toPixmap, toPainter, saveRastered
+*/
+QImage QCustomPlot::toImage(int width, int height, double scale)
+{
+  // this method is the QImage counterpart of toPixmap. Change something here, and a change in toPixmap might be necessary, too.
+  int newWidth, newHeight;
+  if (width == 0 || height == 0)
+  {
+    newWidth = this->width();
+    newHeight = this->height();
+  } else
+  {
+    newWidth = width;
+    newHeight = height;
+  }
+  int scaledWidth = qRound(scale*newWidth);
+  int scaledHeight = qRound(scale*newHeight);
+
+  QImage result(scaledWidth, scaledHeight, QImage::Format_ARGB32_Premultiplied);
+  result.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : Qt::transparent); // if using non-solid pattern, make transparent now and draw brush pattern later
+  QCPPainter painter;
+  painter.begin(&result);
+  if (painter.isActive())
+  {
+    QRect oldViewport = viewport();
+    setViewport(QRect(0, 0, newWidth, newHeight));
+    painter.setMode(QCPPainter::pmNoCaching);
+    if (!qFuzzyCompare(scale, 1.0))
+    {
+      if (scale > 1.0) // for scale < 1 we always want cosmetic pens where possible, because else lines might disappear for very small scales
+        painter.setMode(QCPPainter::pmNonCosmetic);
+      painter.scale(scale, scale);
+    }
+    if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush) // solid fills were done a few lines above with QImage::fill
+      painter.fillRect(mViewport, mBackgroundBrush);
+    draw(&painter);
+    setViewport(oldViewport);
+    painter.end();
+  } else // might happen if image has width or height zero
+  {
+    qDebug() << Q_FUNC_INFO << "Couldn't activate painter on image";
+    return QImage();
+  }
+  return result;
+}
+
 /*!
   Renders the plot using the passed \a painter.
   
@@ -16708,7 +17485,6 @@ void QCPColorGradient::setPeriodic(bool enabled)
 */
 void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor, bool logarithmic)
 {
-  // If you change something here, make sure to also adapt color() and the other colorize() overload
   if (!data)
   {
     qDebug() << Q_FUNC_INFO << "null pointer given as data";
@@ -16719,39 +17495,7 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb
     qDebug() << Q_FUNC_INFO << "null pointer given as scanLine";
     return;
   }
-  if (mColorBufferInvalidated)
-    updateColorBuffer();
-  
-  const bool skipNanCheck = mNanHandling == nhNone;
-  const double posToIndexFactor = !logarithmic ? (mLevelCount-1)/range.size() : (mLevelCount-1)/qLn(range.upper/range.lower);
-  for (int i=0; i<n; ++i)
-  {
-    const double value = data[dataIndexFactor*i];
-    if (skipNanCheck || !std::isnan(value))
-    {
-      qint64 index = qint64((!logarithmic ? value-range.lower : qLn(value/range.lower)) * posToIndexFactor);
-      if (!mPeriodic)
-      {
-        index = qBound(qint64(0), index, qint64(mLevelCount-1));
-      } else
-      {
-        index %= mLevelCount;
-        if (index < 0)
-          index += mLevelCount;
-      }
-      scanLine[i] = mColorBuffer.at(index);
-    } else
-    {
-      switch(mNanHandling)
-      {
-      case nhLowestColor: scanLine[i] = mColorBuffer.first(); break;
-      case nhHighestColor: scanLine[i] = mColorBuffer.last(); break;
-      case nhTransparent: scanLine[i] = qRgba(0, 0, 0, 0); break;
-      case nhNanColor: scanLine[i] = mNanColor.rgba(); break;
-      case nhNone: break; // shouldn't happen
-      }
-    }
-  }
+  colorizeLine(data, nullptr, range, scanLine, n, dataIndexFactor, logarithmic);
 }
 
 /*! \overload
@@ -16764,7 +17508,6 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb
 */
 void QCPColorGradient::colorize(const double *data, const unsigned char *alpha, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor, bool logarithmic)
 {
-  // If you change something here, make sure to also adapt color() and the other colorize() overload
   if (!data)
   {
     qDebug() << Q_FUNC_INFO << "null pointer given as data";
@@ -16780,45 +17523,196 @@ void QCPColorGradient::colorize(const double *data, const unsigned char *alpha,
     qDebug() << Q_FUNC_INFO << "null pointer given as scanLine";
     return;
   }
+  colorizeLine(data, alpha, range, scanLine, n, dataIndexFactor, logarithmic);
+}
+
+#ifdef QCP_SIMD_AVX2
+/*! \internal
+
+  Returns the natural logarithm of the four values in \a x, which must be positive, finite and
+  normal. This is the vectorized counterpart of qLn for \ref QCPColorGradient::colorizeLine: \a x
+  is split into mantissa m (in [sqrt(0.5), sqrt(2))) and exponent e, and ln(x) = e*ln(2)+ln(m),
+  with ln(m) = 2*atanh(s), s = (m-1)/(m+1), summed as a series up to s^17. The relative difference
+  to qLn is below 1e-14, which is far below what colorizeLine tolerates before it falls back to qLn.
+*/
+static inline __m256d qcpLogPd(__m256d x)
+{
+  const __m256i bits = _mm256_castpd_si256(x);
+  __m256d mantissa = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)), _mm256_set1_epi64x(0x3FF0000000000000LL)));
+  __m256i exponent = _mm256_sub_epi64(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(1023));
+  const __m256d large = _mm256_cmp_pd(mantissa, _mm256_set1_pd(1.4142135623730951), _CMP_GE_OQ);
+  mantissa = _mm256_blendv_pd(mantissa, _mm256_mul_pd(mantissa, _mm256_set1_pd(0.5)), large);
+  exponent = _mm256_sub_epi64(exponent, _mm256_castpd_si256(large)); // all bits set is -1
+  // there is no int64 to double conversion in AVX2, but adding the integer to the bits of 1.5*2^52 adds it to the double:
+  const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+  const __m256d exponentF = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(magic), exponent)), magic);
+  
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d s = _mm256_div_pd(_mm256_sub_pd(mantissa, one), _mm256_add_pd(mantissa, one));
+  const __m256d z = _mm256_mul_pd(s, s);
+  static const double coefficients[] = {1.0/15, 1.0/13, 1.0/11, 1.0/9, 1.0/7, 1.0/5, 1.0/3, 1.0};
+  __m256d series = _mm256_set1_pd(1.0/17);
+  for (int k=0; k<8; ++k)
+    series = _mm256_add_pd(_mm256_mul_pd(series, z), _mm256_set1_pd(coefficients[k]));
+  const __m256d logMantissa = _mm256_mul_pd(_mm256_add_pd(s, s), series);
+  // ln(2) split into a part that is exact when multiplied with the exponent, and the rest:
+  return _mm256_add_pd(_mm256_mul_pd(exponentF, _mm256_set1_pd(0.693147180369123816490)),
+                       _mm256_add_pd(_mm256_mul_pd(exponentF, _mm256_set1_pd(1.90821492927058770002e-10)), logMantissa));
+}
+#endif
+
+/*! \internal
+
+  Implements both \ref colorize overloads. \a alpha may be \c nullptr, if the data has no alpha
+  map.
+
+  The linear, non-periodic mapping (the common case) converts two data values per step with SSE2
+  if available, four with AVX2: Clamping the scaled value to the level range before truncating it
+  is equivalent to clamping the truncated index, so the results match the scalar path exactly.
+
+  With AVX2, the logarithmic, non-periodic mapping is vectorized as well, with \ref qcpLogPd
+  instead of qLn. Its result may differ from qLn in the last bits, which only changes the color if
+  the scaled value is almost integral. Such elements, and those whose logarithm isn't finite, are
+  redone with qLn, so the results match the scalar path exactly here, too. Periodic mappings, the
+  logarithmic mapping without AVX2, and the remaining elements use the scalar path.
+*/
+void QCPColorGradient::colorizeLine(const double *data, const unsigned char *alpha, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor, bool logarithmic)
+{
+  // If you change something here, make sure to also adapt color()
   if (mColorBufferInvalidated)
     updateColorBuffer();
   
-  const bool skipNanCheck = mNanHandling == nhNone;
+  // this may run on several threads at once (QCPColorMap bands), so only const access to mColorBuffer from here on,
+  // the non-const QVector accessors (e.g. first(), last()) may detach the buffer:
+  const QRgb *colors = mColorBuffer.constData();
+  const bool checkNan = mNanHandling != nhNone;
+  QRgb nanColor = 0;
+  switch(mNanHandling)
+  {
+  case nhLowestColor: nanColor = colors[0]; break;
+  case nhHighestColor: nanColor = colors[mLevelCount-1]; break;
+  case nhTransparent: nanColor = qRgba(0, 0, 0, 0); break;
+  case nhNanColor: nanColor = mNanColor.rgba(); break;
+  case nhNone: break;
+  }
   const double posToIndexFactor = !logarithmic ? (mLevelCount-1)/range.size() : (mLevelCount-1)/qLn(range.upper/range.lower);
-  for (int i=0; i<n; ++i)
+  
+  int i = 0;
+#ifdef QCP_SIMD_AVX2
+  if (!mPeriodic)
   {
-    const double value = data[dataIndexFactor*i];
-    if (skipNanCheck || !std::isnan(value))
-    {
-      qint64 index = qint64((!logarithmic ? value-range.lower : qLn(value/range.lower)) * posToIndexFactor);
-      if (!mPeriodic)
+    const __m256d lower4 = _mm256_set1_pd(range.lower);
+    const __m256d factor4 = _mm256_set1_pd(posToIndexFactor);
+    const __m256d maxIndex4 = _mm256_set1_pd(mLevelCount-1);
+    const __m256d zero4 = _mm256_setzero_pd();
+    const __m256d one4 = _mm256_set1_pd(1.0);
+    const __m256d minNormal4 = _mm256_set1_pd((std::numeric_limits<double>::min)());
+    const __m256d infinity4 = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d signMask4 = _mm256_set1_pd(-0.0);
+    const __m256d tolerance4 = _mm256_set1_pd(1e-6);
+    for (; i+3<n; i+=4)
+    {
+      const __m256d values = dataIndexFactor == 1 ? _mm256_loadu_pd(data+i) :
+                               _mm256_set_pd(data[dataIndexFactor*(i+3)], data[dataIndexFactor*(i+2)], data[dataIndexFactor*(i+1)], data[dataIndexFactor*i]);
+      __m256d positions;
+      int scalarMask = 0; // elements to redo with qLn
+      if (!logarithmic)
       {
-        index = qBound(qint64(0), index, qint64(mLevelCount-1));
+        positions = _mm256_mul_pd(_mm256_sub_pd(values, lower4), factor4);
       } else
       {
-        index %= mLevelCount;
-        if (index < 0)
-          index += mLevelCount;
+        const __m256d ratios = _mm256_div_pd(values, lower4);
+        const __m256d valid = _mm256_and_pd(_mm256_cmp_pd(ratios, minNormal4, _CMP_GE_OQ), _mm256_cmp_pd(ratios, infinity4, _CMP_LT_OQ));
+        positions = _mm256_mul_pd(qcpLogPd(_mm256_blendv_pd(one4, ratios, valid)), factor4);
+        const __m256d fraction = _mm256_andnot_pd(signMask4, _mm256_sub_pd(positions, _mm256_round_pd(positions, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+        scalarMask = _mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(fraction, tolerance4, _CMP_LT_OQ), _mm256_cmp_pd(valid, zero4, _CMP_EQ_OQ)));
       }
-      if (alpha[dataIndexFactor*i] == 255)
+      // NaN positions become 0 here, because _mm256_max_pd returns its second operand for NaN:
+      positions = _mm256_min_pd(_mm256_max_pd(positions, zero4), maxIndex4);
+      const __m128i indices = _mm256_cvttpd_epi32(positions);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(scanLine+i), _mm_i32gather_epi32(reinterpret_cast<const int*>(colors), indices, 4));
+      const int nanMask = checkNan ? _mm256_movemask_pd(_mm256_cmp_pd(values, values, _CMP_UNORD_Q)) : 0;
+      if (nanMask || scalarMask || alpha)
       {
-        scanLine[i] = mColorBuffer.at(index);
-      } else
+        for (int k=i; k<i+4; ++k)
+        {
+          const int laneBit = 1 << (k-i);
+          if (nanMask & laneBit)
+          {
+            scanLine[k] = nanColor;
+            continue;
+          }
+          if (scalarMask & laneBit)
+            scanLine[k] = colors[qBound(qint64(0), qint64(qLn(data[dataIndexFactor*k]/range.lower)*posToIndexFactor), qint64(mLevelCount-1))];
+          if (alpha && alpha[dataIndexFactor*k] != 255)
+          {
+            const QRgb rgb = scanLine[k];
+            const float alphaF = alpha[dataIndexFactor*k]/255.0f;
+            scanLine[k] = qRgba(int(qRed(rgb)*alphaF), int(qGreen(rgb)*alphaF), int(qBlue(rgb)*alphaF), int(qAlpha(rgb)*alphaF)); // also multiply r,g,b with alpha, to conform to Format_ARGB32_Premultiplied
+          }
+        }
+      }
+    }
+  }
+#endif
+#ifdef QCP_SIMD_SSE2
+  if (!logarithmic && !mPeriodic)
+  {
+    const __m128d lower2 = _mm_set1_pd(range.lower);
+    const __m128d factor2 = _mm_set1_pd(posToIndexFactor);
+    const __m128d maxIndex2 = _mm_set1_pd(mLevelCount-1);
+    const __m128d zero2 = _mm_setzero_pd();
+    for (; i+1<n; i+=2)
+    {
+      const __m128d values = dataIndexFactor == 1 ? _mm_loadu_pd(data+i) : _mm_set_pd(data[dataIndexFactor*(i+1)], data[dataIndexFactor*i]);
+      // NaN positions become 0 here, because _mm_max_pd returns its second operand for NaN:
+      const __m128d positions = _mm_min_pd(_mm_max_pd(_mm_mul_pd(_mm_sub_pd(values, lower2), factor2), zero2), maxIndex2);
+      const __m128i indices = _mm_cvttpd_epi32(positions);
+      const int nanMask = checkNan ? _mm_movemask_pd(_mm_cmpunord_pd(values, values)) : 0;
+      scanLine[i] = nanMask & 1 ? nanColor : colors[_mm_cvtsi128_si32(indices)];
+      scanLine[i+1] = nanMask & 2 ? nanColor : colors[_mm_cvtsi128_si32(_mm_srli_si128(indices, 4))];
+      if (alpha)
       {
-        const QRgb rgb = mColorBuffer.at(index);
-        const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-        scanLine[i] = qRgba(int(qRed(rgb)*alphaF), int(qGreen(rgb)*alphaF), int(qBlue(rgb)*alphaF), int(qAlpha(rgb)*alphaF)); // also multiply r,g,b with alpha, to conform to Format_ARGB32_Premultiplied
+        for (int k=i; k<i+2; ++k)
+        {
+          if (alpha[dataIndexFactor*k] != 255 && !(nanMask & (1 << (k-i))))
+          {
+            const QRgb rgb = scanLine[k];
+            const float alphaF = alpha[dataIndexFactor*k]/255.0f;
+            scanLine[k] = qRgba(int(qRed(rgb)*alphaF), int(qGreen(rgb)*alphaF), int(qBlue(rgb)*alphaF), int(qAlpha(rgb)*alphaF)); // also multiply r,g,b with alpha, to conform to Format_ARGB32_Premultiplied
+          }
+        }
       }
+    }
+  }
+#endif
+  
+  for (; i<n; ++i)
+  {
+    const double value = data[dataIndexFactor*i];
+    if (checkNan && std::isnan(value))
+    {
+      scanLine[i] = nanColor;
+      continue;
+    }
+    qint64 index = qint64((!logarithmic ? value-range.lower : qLn(value/range.lower)) * posToIndexFactor);
+    if (!mPeriodic)
+    {
+      index = qBound(qint64(0), index, qint64(mLevelCount-1));
     } else
     {
-      switch(mNanHandling)
-      {
-      case nhLowestColor: scanLine[i] = mColorBuffer.first(); break;
-      case nhHighestColor: scanLine[i] = mColorBuffer.last(); break;
-      case nhTransparent: scanLine[i] = qRgba(0, 0, 0, 0); break;
-      case nhNanColor: scanLine[i] = mNanColor.rgba(); break;
-      case nhNone: break; // shouldn't happen
-      }
+      index %= mLevelCount;
+      if (index < 0)
+        index += mLevelCount;
+    }
+    if (!alpha || alpha[dataIndexFactor*i] == 255)
+    {
+      scanLine[i] = colors[index];
+    } else
+    {
+      const QRgb rgb = colors[index];
+      const float alphaF = alpha[dataIndexFactor*i]/255.0f;
+      scanLine[i] = qRgba(int(qRed(rgb)*alphaF), int(qGreen(rgb)*alphaF), int(qBlue(rgb)*alphaF), int(qAlpha(rgb)*alphaF)); // also multiply r,g,b with alpha, to conform to Format_ARGB32_Premultiplied
     }
   }
 }
@@ -21130,6 +22024,7 @@ void QCPGraph::draw(QCPPainter *painter)
   if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
   
   QVector<QPointF> lines, scatters; // line and (if necessary) scatter pixel coordinates will be stored here while iterating over segments
+  const QCPDataRange clipDataRange = getClipDataRange(painter); // only the data that can reach into the clip rect
   
   // loop over and draw segments of unselected/selected data:
   QList<QCPDataRange> selectedSegments, unselectedSegments, allSegments;
@@ -21140,7 +22035,7 @@ void QCPGraph::draw(QCPPainter *painter)
     bool isSelectedSegment = i >= unselectedSegments.size();
     // get line pixel points appropriate to line style:
     QCPDataRange lineDataRange = isSelectedSegment ? allSegments.at(i) : allSegments.at(i).adjusted(-1, 1); // unselected segments extend lines to bordering selected data point (safe to exceed total data bounds in first/last segment, getLines takes care)
-    getLines(&lines, lineDataRange);
+    getLines(&lines, lineDataRange.bounded(clipDataRange));
     
     // check data validity if flag set:
 #ifdef QCUSTOMPLOT_CHECK_DATA
@@ -21180,7 +22075,7 @@ void QCPGraph::draw(QCPPainter *painter)
       finalScatterStyle = mSelectionDecorator->getFinalScatterStyle(mScatterStyle);
     if (!finalScatterStyle.isNone())
     {
-      getScatters(&scatters, allSegments.at(i));
+      getScatters(&scatters, allSegments.at(i).bounded(clipDataRange));
       drawScatterPlot(painter, scatters, finalScatterStyle);
     }
   }
@@ -21307,27 +22202,61 @@ void QCPGraph::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataR
   if (mKeyAxis->rangeReversed() != (mKeyAxis->orientation() == Qt::Vertical)) // make sure key pixels are sorted ascending in data (significantly simplifies following processing)
     std::reverse(data.begin(), data.end());
   
-  scatters->resize(data.size());
-  if (keyAxis->orientation() == Qt::Vertical)
+  *scatters = dataToLines(data);
+  for (int i=0; i<data.size(); ++i)
   {
-    for (int i=0; i<data.size(); ++i)
+    if (qIsNaN(data.at(i).value)) // NaN data points aren't converted, they stay at the origin
+      (*scatters)[i] = QPointF();
+  }
+}
+
+/*! \internal
+
+  Transforms \a count data points to pixel coordinates, for the case that both \a keyAxis and \a
+  valueAxis are linear. The orientation and range reversal of the axes are resolved once up front,
+  so that each data point goes through the same affine transformation (offset, scale, offset).
+
+  QCPGraphData (key, value) and QPointF (x, y) both consist of two consecutive doubles. So with
+  SSE2, a whole data point is transformed with one subtraction, multiplication and addition, and
+  the key and value are swapped with one shuffle if the key axis is vertical.
+*/
+static void qcpGraphDataToPixels(const QCPGraphData *data, QPointF *pixels, int count, const QCPAxis *keyAxis, const QCPAxis *valueAxis)
+{
+  // pixel = (coord-coordOrigin)*scale+pixelOrigin, using the lower range bound as origin keeps the precision of coordToPixel:
+  const double keyOrigin = keyAxis->range().lower;
+  const double keyPixelOrigin = keyAxis->coordToPixel(keyOrigin);
+  const double keyScale = (keyAxis->coordToPixel(keyAxis->range().upper)-keyPixelOrigin)/keyAxis->range().size();
+  const double valueOrigin = valueAxis->range().lower;
+  const double valuePixelOrigin = valueAxis->coordToPixel(valueOrigin);
+  const double valueScale = (valueAxis->coordToPixel(valueAxis->range().upper)-valuePixelOrigin)/valueAxis->range().size();
+  const bool keyVertical = keyAxis->orientation() == Qt::Vertical;
+  int i = 0;
+#if defined(QCP_SIMD_SSE2) && !defined(QT_COORD_TYPE) // QPointF must consist of doubles
+  const __m128d origin = _mm_set_pd(valueOrigin, keyOrigin); // _mm_set_pd takes the high lane first
+  const __m128d scale = _mm_set_pd(valueScale, keyScale);
+  const __m128d pixelOrigin = _mm_set_pd(valuePixelOrigin, keyPixelOrigin);
+  double *out = reinterpret_cast<double*>(pixels);
+  if (keyVertical)
+  {
+    for (; i<count; ++i)
     {
-      if (!qIsNaN(data.at(i).value))
-      {
-        (*scatters)[i].setX(valueAxis->coordToPixel(data.at(i).value));
-        (*scatters)[i].setY(keyAxis->coordToPixel(data.at(i).key));
-      }
+      const __m128d pixel = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(&data[i].key), origin), scale), pixelOrigin);
+      _mm_storeu_pd(out+2*i, _mm_shuffle_pd(pixel, pixel, 1));
     }
   } else
   {
-    for (int i=0; i<data.size(); ++i)
-    {
-      if (!qIsNaN(data.at(i).value))
-      {
-        (*scatters)[i].setX(keyAxis->coordToPixel(data.at(i).key));
-        (*scatters)[i].setY(valueAxis->coordToPixel(data.at(i).value));
-      }
-    }
+    for (; i<count; ++i)
+      _mm_storeu_pd(out+2*i, _mm_add_pd(_mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(&data[i].key), origin), scale), pixelOrigin));
+  }
+#endif
+  for (; i<count; ++i)
+  {
+    const double keyPixel = (data[i].key-keyOrigin)*keyScale+keyPixelOrigin;
+    const double valuePixel = (data[i].value-valueOrigin)*valueScale+valuePixelOrigin;
+    if (keyVertical)
+      pixels[i] = QPointF(valuePixel, keyPixel);
+    else
+      pixels[i] = QPointF(keyPixel, valuePixel);
   }
 }
 
@@ -21351,20 +22280,16 @@ QVector<QPointF> QCPGraph::dataToLines(const QVector<QCPGraphData> &data) const
   result.resize(data.size());
   
   // transform data points to pixels:
-  if (keyAxis->orientation() == Qt::Vertical)
+  if (data.isEmpty())
+    return result;
+  if (keyAxis->scaleType() == QCPAxis::stLinear && valueAxis->scaleType() == QCPAxis::stLinear)
   {
-    for (int i=0; i<data.size(); ++i)
-    {
-      result[i].setX(valueAxis->coordToPixel(data.at(i).value));
-      result[i].setY(keyAxis->coordToPixel(data.at(i).key));
-    }
-  } else // key axis is horizontal
+    qcpGraphDataToPixels(data.constData(), result.data(), data.size(), keyAxis, valueAxis);
+  } else
   {
-    for (int i=0; i<data.size(); ++i)
-    {
-      result[i].setX(keyAxis->coordToPixel(data.at(i).key));
-      result[i].setY(valueAxis->coordToPixel(data.at(i).value));
-    }
+    const int stride = int(sizeof(QCPGraphData)/sizeof(double));
+    keyAxis->coordsToPixels(&data.constData()->key, stride, result.data(), data.size());
+    valueAxis->coordsToPixels(&data.constData()->value, stride, result.data(), data.size());
   }
   return result;
 }
@@ -21386,30 +22311,30 @@ QVector<QPointF> QCPGraph::dataToStepLeftLines(const QVector<QCPGraphData> &data
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
   
+  // transform data points to pixels in one batch, then calculate steps from them:
+  const QVector<QPointF> points = dataToLines(data);
   result.resize(data.size()*2);
-  
-  // calculate steps from data and transform to pixel coordinates:
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    for (int i=0; i<data.size(); ++i)
+    double lastValue = points.first().x();
+    for (int i=0; i<points.size(); ++i)
     {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
+      const double key = points.at(i).y();
       result[i*2+0].setX(lastValue);
       result[i*2+0].setY(key);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
+      lastValue = points.at(i).x();
       result[i*2+1].setX(lastValue);
       result[i*2+1].setY(key);
     }
   } else // key axis is horizontal
   {
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    for (int i=0; i<data.size(); ++i)
+    double lastValue = points.first().y();
+    for (int i=0; i<points.size(); ++i)
     {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
+      const double key = points.at(i).x();
       result[i*2+0].setX(key);
       result[i*2+0].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
+      lastValue = points.at(i).y();
       result[i*2+1].setX(key);
       result[i*2+1].setY(lastValue);
     }
@@ -21434,30 +22359,30 @@ QVector<QPointF> QCPGraph::dataToStepRightLines(const QVector<QCPGraphData> &dat
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
   
+  // transform data points to pixels in one batch, then calculate steps from them:
+  const QVector<QPointF> points = dataToLines(data);
   result.resize(data.size()*2);
-  
-  // calculate steps from data and transform to pixel coordinates:
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    for (int i=0; i<data.size(); ++i)
+    double lastKey = points.first().y();
+    for (int i=0; i<points.size(); ++i)
     {
-      const double value = valueAxis->coordToPixel(data.at(i).value);
+      const double value = points.at(i).x();
       result[i*2+0].setX(value);
       result[i*2+0].setY(lastKey);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
+      lastKey = points.at(i).y();
       result[i*2+1].setX(value);
       result[i*2+1].setY(lastKey);
     }
   } else // key axis is horizontal
   {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    for (int i=0; i<data.size(); ++i)
+    double lastKey = points.first().x();
+    for (int i=0; i<points.size(); ++i)
     {
-      const double value = valueAxis->coordToPixel(data.at(i).value);
+      const double value = points.at(i).y();
       result[i*2+0].setX(lastKey);
       result[i*2+0].setY(value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
+      lastKey = points.at(i).x();
       result[i*2+1].setX(lastKey);
       result[i*2+1].setY(value);
     }
@@ -21482,22 +22407,22 @@ QVector<QPointF> QCPGraph::dataToStepCenterLines(const QVector<QCPGraphData> &da
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
   
+  // transform data points to pixels in one batch, then calculate steps from them:
+  const QVector<QPointF> points = dataToLines(data);
   result.resize(data.size()*2);
-  
-  // calculate steps from data and transform to pixel coordinates:
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    double lastValue = valueAxis->coordToPixel(data.first().value);
+    double lastKey = points.first().y();
+    double lastValue = points.first().x();
     result[0].setX(lastValue);
     result[0].setY(lastKey);
-    for (int i=1; i<data.size(); ++i)
+    for (int i=1; i<points.size(); ++i)
     {
-      const double key = (keyAxis->coordToPixel(data.at(i).key)+lastKey)*0.5;
+      const double key = (points.at(i).y()+lastKey)*0.5;
       result[i*2-1].setX(lastValue);
       result[i*2-1].setY(key);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
+      lastValue = points.at(i).x();
+      lastKey = points.at(i).y();
       result[i*2+0].setX(lastValue);
       result[i*2+0].setY(key);
     }
@@ -21505,17 +22430,17 @@ QVector<QPointF> QCPGraph::dataToStepCenterLines(const QVector<QCPGraphData> &da
     result[data.size()*2-1].setY(lastKey);
   } else // key axis is horizontal
   {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    double lastValue = valueAxis->coordToPixel(data.first().value);
+    double lastKey = points.first().x();
+    double lastValue = points.first().y();
     result[0].setX(lastKey);
     result[0].setY(lastValue);
-    for (int i=1; i<data.size(); ++i)
+    for (int i=1; i<points.size(); ++i)
     {
-      const double key = (keyAxis->coordToPixel(data.at(i).key)+lastKey)*0.5;
+      const double key = (points.at(i).x()+lastKey)*0.5;
       result[i*2-1].setX(key);
       result[i*2-1].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
+      lastValue = points.at(i).y();
+      lastKey = points.at(i).x();
       result[i*2+0].setX(key);
       result[i*2+0].setY(lastValue);
     }
@@ -21542,21 +22467,19 @@ QVector<QPointF> QCPGraph::dataToImpulseLines(const QVector<QCPGraphData> &data)
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
   
+  // transform data points to pixels in one batch, then add the base points:
+  const QVector<QPointF> points = dataToLines(data);
+  const double zeroValue = valueAxis->coordToPixel(0);
   result.resize(data.size()*2);
-  
-  // transform data points to pixels:
   if (keyAxis->orientation() == Qt::Vertical)
   {
     for (int i=0; i<data.size(); ++i)
     {
-      const QCPGraphData &current = data.at(i);
-      if (!qIsNaN(current.value))
+      if (!qIsNaN(data.at(i).value))
       {
-        const double key = keyAxis->coordToPixel(current.key);
-        result[i*2+0].setX(valueAxis->coordToPixel(0));
-        result[i*2+0].setY(key);
-        result[i*2+1].setX(valueAxis->coordToPixel(current.value));
-        result[i*2+1].setY(key);
+        result[i*2+0].setX(zeroValue);
+        result[i*2+0].setY(points.at(i).y());
+        result[i*2+1] = points.at(i);
       } else
       {
         result[i*2+0] = QPointF(0, 0);
@@ -21567,14 +22490,11 @@ QVector<QPointF> QCPGraph::dataToImpulseLines(const QVector<QCPGraphData> &data)
   {
     for (int i=0; i<data.size(); ++i)
     {
-      const QCPGraphData &current = data.at(i);
-      if (!qIsNaN(current.value))
+      if (!qIsNaN(data.at(i).value))
       {
-        const double key = keyAxis->coordToPixel(data.at(i).key);
-        result[i*2+0].setX(key);
-        result[i*2+0].setY(valueAxis->coordToPixel(0));
-        result[i*2+1].setX(key);
-        result[i*2+1].setY(valueAxis->coordToPixel(data.at(i).value));
+        result[i*2+0].setX(points.at(i).x());
+        result[i*2+0].setY(zeroValue);
+        result[i*2+1] = points.at(i);
       } else
       {
         result[i*2+0] = QPointF(0, 0);
@@ -21710,7 +22630,10 @@ void QCPGraph::getOptimizedLineData(QVector<QCPGraphData> *lineData, const QCPGr
       maxCount = int(2*keyPixelSpan+2);
   }
   
-  if (mAdaptiveSampling && dataCount >= maxCount) // use adaptive sampling only if there are at least two points per pixel on average
+  if (mAdaptiveSampling && dataCount >= 8*maxCount && (mDataContainer->minMaxPyramid() || keyAxis->scaleType() == QCPAxis::stLinear)) // with many points per pixel, reduce whole pixel intervals at once
+  {
+    getClusteredLineData(lineData, begin, end);
+  } else if (mAdaptiveSampling && dataCount >= maxCount) // use adaptive sampling only if there are at least two points per pixel on average
   {
     QCPGraphDataContainer::const_iterator it = begin;
     double minValue = it->value;
@@ -21775,30 +22698,219 @@ void QCPGraph::getOptimizedLineData(QVector<QCPGraphData> *lineData, const QCPGr
 
 /*! \internal
 
-  Returns via \a scatterData the data points that need to be visualized for this graph when
-  plotting scatter points, taking into consideration the currently visible axis ranges and, if \ref
-  setAdaptiveSampling is enabled, local point densities. The considered data can be restricted
-  further by \a begin and \a end, e.g. to only plot a certain segment of the data (see \ref
-  getDataSegments).
-
-  This method is used by \ref getScatters to retrieve the basic working set of data.
+  Returns the smallest and largest value of the data points from \a first to \a last (exclusive)
+  in \a minValue and \a maxValue, ignoring NaN values. If there is no non-NaN value, \a minValue is
+  positive and \a maxValue negative infinity.
 
-  \see getOptimizedLineData
+  This is the inner loop of the adaptive sampling in \ref QCPGraph::getClusteredLineData. If SSE2
+  is available, two data points are reduced per instruction (four with AVX2), with the min/max
+  operands ordered such that NaN values never replace the accumulated bounds.
 */
-void QCPGraph::getOptimizedScatterData(QVector<QCPGraphData> *scatterData, QCPGraphDataContainer::const_iterator begin, QCPGraphDataContainer::const_iterator end) const
+static void qcpGraphValueBounds(const QCPGraphData *first, const QCPGraphData *last, double &minValue, double &maxValue)
 {
-  if (!scatterData) return;
-  QCPAxis *keyAxis = mKeyAxis.data();
-  QCPAxis *valueAxis = mValueAxis.data();
-  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
-  
-  const int scatterModulo = mScatterSkip+1;
-  const bool doScatterSkip = mScatterSkip > 0;
-  int beginIndex = int(begin-mDataContainer->constBegin());
-  int endIndex = int(end-mDataContainer->constBegin());
-  while (doScatterSkip && begin != end && beginIndex % scatterModulo != 0) // advance begin iterator to first non-skipped scatter
+  minValue = std::numeric_limits<double>::infinity();
+  maxValue = -std::numeric_limits<double>::infinity();
+#ifdef QCP_SIMD_AVX2
+  if (last-first >= 8)
   {
-    ++beginIndex;
+    __m256d minA = _mm256_set1_pd(minValue), minB = minA;
+    __m256d maxA = _mm256_set1_pd(maxValue), maxB = maxA;
+    for (; last-first >= 8; first += 8)
+    {
+      // unpackhi works per 128 bit lane, so this gathers the values of four pairs in the order 0, 2, 1, 3:
+      const __m256d values0123 = _mm256_unpackhi_pd(_mm256_loadu_pd(&first[0].key), _mm256_loadu_pd(&first[2].key));
+      const __m256d values4567 = _mm256_unpackhi_pd(_mm256_loadu_pd(&first[4].key), _mm256_loadu_pd(&first[6].key));
+      minA = _mm256_min_pd(values0123, minA);
+      maxA = _mm256_max_pd(values0123, maxA);
+      minB = _mm256_min_pd(values4567, minB);
+      maxB = _mm256_max_pd(values4567, maxB);
+    }
+    minA = _mm256_min_pd(minA, minB);
+    maxA = _mm256_max_pd(maxA, maxB);
+    const __m128d mins = _mm_min_pd(_mm256_castpd256_pd128(minA), _mm256_extractf128_pd(minA, 1));
+    const __m128d maxs = _mm_max_pd(_mm256_castpd256_pd128(maxA), _mm256_extractf128_pd(maxA, 1));
+    minValue = qMin(_mm_cvtsd_f64(mins), _mm_cvtsd_f64(_mm_unpackhi_pd(mins, mins)));
+    maxValue = qMax(_mm_cvtsd_f64(maxs), _mm_cvtsd_f64(_mm_unpackhi_pd(maxs, maxs)));
+  }
+#endif
+#ifdef QCP_SIMD_SSE2
+  if (last-first >= 4)
+  {
+    __m128d minA = _mm_set1_pd(minValue), minB = minA;
+    __m128d maxA = _mm_set1_pd(maxValue), maxB = maxA;
+    for (; last-first >= 4; first += 4)
+    {
+      // gather the values of four (key, value) pairs into two registers:
+      const __m128d values01 = _mm_unpackhi_pd(_mm_loadu_pd(&first[0].key), _mm_loadu_pd(&first[1].key));
+      const __m128d values23 = _mm_unpackhi_pd(_mm_loadu_pd(&first[2].key), _mm_loadu_pd(&first[3].key));
+      // _mm_min_pd/_mm_max_pd return the second operand if either is NaN, so keep the accumulator second:
+      minA = _mm_min_pd(values01, minA);
+      maxA = _mm_max_pd(values01, maxA);
+      minB = _mm_min_pd(values23, minB);
+      maxB = _mm_max_pd(values23, maxB);
+    }
+    double mins[2], maxs[2];
+    _mm_storeu_pd(mins, _mm_min_pd(minA, minB));
+    _mm_storeu_pd(maxs, _mm_max_pd(maxA, maxB));
+    minValue = qMin(mins[0], mins[1]);
+    maxValue = qMax(maxs[0], maxs[1]);
+  }
+#endif
+  for (; first != last; ++first)
+  {
+    if (first->value < minValue) minValue = first->value;
+    if (first->value > maxValue) maxValue = first->value;
+  }
+}
+
+/*! \internal
+
+  Returns the range of data indices that can be visible inside the clip rect of \a painter.
+
+  Normally the clip rect spans the whole axis rect along the key axis, then the full data range is
+  returned. If it is narrower, e.g. only the strip exposed by a scrolled layer (see \ref
+  QCPLayer::setScrollAxis), the returned range covers the keys inside the clip rect, widened by the
+  pen width, the scatter size and a few pixels, plus the data point before and after it. So lines
+  and scatters are generated only for the part of the graph that is actually repainted. The
+  adaptive sampling clusters the data in whole key pixels regardless of where the range begins, so
+  the part inside the clip rect comes out the same as if the whole graph was drawn.
+
+  Graphs with a channel fill (\ref setChannelFillGraph) always use the full data range, because
+  the fill polygon is matched against the other graph.
+*/
+QCPDataRange QCPGraph::getClipDataRange(const QCPPainter *painter) const
+{
+  const QCPDataRange fullRange(0, dataCount());
+  QCPAxis *keyAxis = mKeyAxis.data();
+  if (!keyAxis || !keyAxis->axisRect() || !painter->hasClipping() || mChannelFillGraph)
+    return fullRange;
+  
+  const QRectF clipRect = painter->clipBoundingRect();
+  const QRectF axisRect = keyAxis->axisRect()->rect();
+  const bool horizontal = keyAxis->orientation() == Qt::Horizontal;
+  const double clipBegin = horizontal ? clipRect.left() : clipRect.top();
+  const double clipEnd = horizontal ? clipRect.right() : clipRect.bottom();
+  if (clipBegin <= (horizontal ? axisRect.left() : axisRect.top())+1 && clipEnd >= (horizontal ? axisRect.right() : axisRect.bottom())-1)
+    return fullRange;
+  
+  // lines, wide pens and scatters of data points outside the clip rect may still reach into it:
+  double extent = mPen.widthF();
+  if (mSelectionDecorator)
+    extent = qMax(extent, mSelectionDecorator->pen().widthF());
+  if (!mScatterStyle.isNone())
+    extent += mScatterStyle.size();
+  const double margin = qCeil(extent)+3;
+  double lower = keyAxis->pixelToCoord(clipBegin-margin);
+  double upper = keyAxis->pixelToCoord(clipEnd+margin);
+  if (lower > upper)
+    qSwap(lower, upper);
+  const QCPGraphDataContainer::const_iterator begin = mDataContainer->findBegin(lower);
+  const QCPGraphDataContainer::const_iterator end = mDataContainer->findEnd(upper);
+  return QCPDataRange(int(begin-mDataContainer->constBegin()), int(end-mDataContainer->constBegin()));
+}
+
+/*! \internal
+
+  Produces the same clusters as the adaptive sampling in \ref getOptimizedLineData, but instead of
+  visiting every data point in a branchy loop, it reduces whole pixel intervals at once: The end of
+  each interval is found with an exponential search over the keys, and the minimum and maximum
+  value of the interval come either from the min/max pyramid of the data container (see \ref
+  QCPDataContainer::setMinMaxPyramid) or from the vectorized \ref qcpGraphValueBounds.
+
+  For linear key axes, the interval boundaries are calculated from the linear pixel mapping
+  directly, instead of two axis transformations per interval.
+
+  This method is used by \ref getOptimizedLineData if there are many data points per pixel.
+*/
+void QCPGraph::getClusteredLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPGraphDataContainer::const_iterator it = begin;
+  const bool usePyramid = mDataContainer->minMaxPyramid();
+  int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  // linear pixel mapping pixel = keyPixelOrigin + (key-keyOrigin)*keyPixelScale (only used for linear axes):
+  const bool keyLinear = keyAxis->scaleType() == QCPAxis::stLinear;
+  const double keyOrigin = keyAxis->range().lower;
+  const double keyPixelOrigin = keyAxis->coordToPixel(keyOrigin);
+  const double keyPixelScale = (keyAxis->coordToPixel(keyAxis->range().upper)-keyPixelOrigin)/keyAxis->range().size();
+  double currentIntervalStartKey = keyLinear ? keyOrigin+(int(keyPixelOrigin+(begin->key-keyOrigin)*keyPixelScale+reversedRound)-keyPixelOrigin)/keyPixelScale
+                                             : keyAxis->pixelToCoord(int(keyAxis->coordToPixel(begin->key)+reversedRound));
+  double lastIntervalEndKey = currentIntervalStartKey;
+  double keyEpsilon = keyLinear ? qAbs(1.0/keyPixelScale) // interval of one pixel on screen when mapped to plot key coordinates
+                                : qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+  while (true)
+  {
+    // find the first data point beyond the current pixel interval (exponential, then binary search):
+    const QCPGraphData intervalEndData = QCPGraphData::fromSortKey(currentIntervalStartKey+keyEpsilon);
+    int step = 1;
+    while (step < int(end-it) && qcpLessThanSortKey<QCPGraphData>(*(it+step), intervalEndData))
+      step *= 2;
+    QCPGraphDataContainer::const_iterator intervalEnd = std::lower_bound(it+step/2+1, it+qMin(step, int(end-it)), intervalEndData, qcpLessThanSortKey<QCPGraphData>);
+    
+    if (intervalEnd-it >= 2) // pixel has multiple data points, consolidate them to a cluster
+    {
+      double minValue = it->value;
+      double maxValue = it->value;
+      if (!qIsNaN(it->value)) // like in getOptimizedLineData, a NaN first value stays the cluster value
+      {
+        if (usePyramid)
+        {
+          const QCPRange bounds = mDataContainer->mainValueBounds(it, intervalEnd);
+          minValue = bounds.lower;
+          maxValue = bounds.upper;
+        } else
+          qcpGraphValueBounds(&*it, &*it+(intervalEnd-it), minValue, maxValue);
+      }
+      if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, it->value));
+      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+      if (intervalEnd != end && intervalEnd->key > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.8, (intervalEnd-1)->value));
+    } else
+      lineData->append(QCPGraphData(it->key, it->value));
+    
+    if (intervalEnd == end)
+      break;
+    lastIntervalEndKey = (intervalEnd-1)->key;
+    it = intervalEnd;
+    if (keyLinear)
+      currentIntervalStartKey = keyOrigin+(int(keyPixelOrigin+(it->key-keyOrigin)*keyPixelScale+reversedRound)-keyPixelOrigin)/keyPixelScale;
+    else
+    {
+      currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(it->key)+reversedRound));
+      keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // keyEpsilon varies on logarithmic axes
+    }
+  }
+}
+
+/*! \internal
+
+  Returns via \a scatterData the data points that need to be visualized for this graph when
+  plotting scatter points, taking into consideration the currently visible axis ranges and, if \ref
+  setAdaptiveSampling is enabled, local point densities. The considered data can be restricted
+  further by \a begin and \a end, e.g. to only plot a certain segment of the data (see \ref
+  getDataSegments).
+
+  This method is used by \ref getScatters to retrieve the basic working set of data.
+
+  \see getOptimizedLineData
+*/
+void QCPGraph::getOptimizedScatterData(QVector<QCPGraphData> *scatterData, QCPGraphDataContainer::const_iterator begin, QCPGraphDataContainer::const_iterator end) const
+{
+  if (!scatterData) return;
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+  
+  const int scatterModulo = mScatterSkip+1;
+  const bool doScatterSkip = mScatterSkip > 0;
+  int beginIndex = int(begin-mDataContainer->constBegin());
+  int endIndex = int(end-mDataContainer->constBegin());
+  while (doScatterSkip && begin != end && beginIndex % scatterModulo != 0) // advance begin iterator to first non-skipped scatter
+  {
+    ++beginIndex;
     ++begin;
   }
   if (begin == end) return;
@@ -22438,13 +23550,21 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer:
   // iterate over found data points and then choose the one with the shortest distance to pos:
   QCPGraphDataContainer::const_iterator begin = mDataContainer->findBegin(posKeyMin, true);
   QCPGraphDataContainer::const_iterator end = mDataContainer->findEnd(posKeyMax, true);
-  for (QCPGraphDataContainer::const_iterator it=begin; it!=end; ++it)
+  if (begin != end)
   {
-    const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
-    if (currentDistSqr < minDistSqr)
+    // transform the data points to pixels in one batch per axis:
+    QVector<QPointF> points(int(end-begin));
+    const int stride = int(sizeof(QCPGraphData)/sizeof(double));
+    mKeyAxis.data()->coordsToPixels(&begin->key, stride, points.data(), points.size());
+    mValueAxis.data()->coordsToPixels(&begin->value, stride, points.data(), points.size());
+    for (int i=0; i<points.size(); ++i)
     {
-      minDistSqr = currentDistSqr;
-      closestData = it;
+      const double currentDistSqr = QCPVector2D(points.at(i)-pixelPoint).lengthSquared();
+      if (currentDistSqr < minDistSqr)
+      {
+        minDistSqr = currentDistSqr;
+        closestData = begin+i;
+      }
     }
   }
     
@@ -23088,6 +24208,7 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
   QCPCurveDataContainer::const_iterator prevIt = itEnd-1;
   int prevRegion = getRegion(prevIt->key, prevIt->value, keyMin, valueMax, keyMax, valueMin);
   QVector<QPointF> trailingPoints; // points that must be applied after all other points (are generated only when handling first point to get virtual segment between last and first point right)
+  QCPCurveDataContainer::const_iterator runBegin = itBegin; // first point of the current run of original points inside R, converted in one go when the run ends
   while (it != itEnd)
   {
     const int currentRegion = getRegion(it->key, it->value, keyMin, valueMax, keyMax, valueMin);
@@ -23098,6 +24219,7 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
         QPointF crossA, crossB;
         if (prevRegion == 5) // we're coming from R, so add this point optimized
         {
+          appendCurvePixels(lines, runBegin, it);
           lines->append(getOptimizedPoint(currentRegion, it->key, it->value, prevIt->key, prevIt->value, keyMin, valueMax, keyMax, valueMin));
           // in the situations 5->1/7/9/3 the segment may leave R and directly cross through two outer regions. In these cases we need to add an additional corner point
           *lines << getOptimizedCornerPoints(prevRegion, currentRegion, prevIt->key, prevIt->value, it->key, it->value, keyMin, valueMax, keyMax, valueMin);
@@ -23129,13 +24251,13 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
           trailingPoints << getOptimizedPoint(prevRegion, prevIt->key, prevIt->value, it->key, it->value, keyMin, valueMax, keyMax, valueMin);
         else
           lines->append(getOptimizedPoint(prevRegion, prevIt->key, prevIt->value, it->key, it->value, keyMin, valueMax, keyMax, valueMin));
-        lines->append(coordsToPixels(it->key, it->value));
+        runBegin = it;
       }
     } else // region didn't change
     {
       if (currentRegion == 5) // still in R, keep adding original points
       {
-        lines->append(coordsToPixels(it->key, it->value));
+        // nothing to do here, the point extends the current run which is converted by appendCurvePixels when it ends
       } else // still outside R, no need to add anything
       {
         // see how this is not doing anything? That's the main optimization...
@@ -23145,9 +24267,29 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
     prevRegion = currentRegion;
     ++it;
   }
+  if (prevRegion == 5)
+    appendCurvePixels(lines, runBegin, itEnd);
   *lines << trailingPoints;
 }
 
+/*! \internal
+
+  Appends the pixel positions of the data points from \a begin up to (but not including) \a end to
+  \a lines. The points are converted in one batch per axis with \ref QCPAxis::coordsToPixels, which
+  is used by \ref getCurveLines for consecutive points inside the visible axis rect.
+*/
+void QCPCurve::appendCurvePixels(QVector<QPointF> *lines, QCPCurveDataContainer::const_iterator begin, QCPCurveDataContainer::const_iterator end) const
+{
+  const int count = int(end-begin);
+  if (count <= 0)
+    return;
+  const int oldSize = lines->size();
+  lines->resize(oldSize+count);
+  const int stride = int(sizeof(QCPCurveData)/sizeof(double));
+  mKeyAxis.data()->coordsToPixels(&begin->key, stride, lines->data()+oldSize, count);
+  mValueAxis.data()->coordsToPixels(&begin->value, stride, lines->data()+oldSize, count);
+}
+
 /*! \internal
 
   Called by \ref draw to generate points in pixel coordinates which represent the scatters of the
@@ -23200,51 +24342,34 @@ void QCPCurve::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataR
     ++itIndex;
     ++it;
   }
-  if (keyAxis->orientation() == Qt::Vertical)
+  // collect the visible points, then transform them to pixels in one batch per axis:
+  QVector<double> keys, values;
+  while (it != end)
   {
-    while (it != end)
+    if (!qIsNaN(it->value) && keyRange.contains(it->key) && valueRange.contains(it->value))
     {
-      if (!qIsNaN(it->value) && keyRange.contains(it->key) && valueRange.contains(it->value))
-        scatters->append(QPointF(valueAxis->coordToPixel(it->value), keyAxis->coordToPixel(it->key)));
-      
-      // advance iterator to next (non-skipped) data point:
-      if (!doScatterSkip)
-        ++it;
-      else
-      {
-        itIndex += scatterModulo;
-        if (itIndex < endIndex) // make sure we didn't jump over end
-          it += scatterModulo;
-        else
-        {
-          it = end;
-          itIndex = endIndex;
-        }
-      }
+      keys.append(it->key);
+      values.append(it->value);
     }
-  } else
-  {
-    while (it != end)
+    
+    // advance iterator to next (non-skipped) data point:
+    if (!doScatterSkip)
+      ++it;
+    else
     {
-      if (!qIsNaN(it->value) && keyRange.contains(it->key) && valueRange.contains(it->value))
-        scatters->append(QPointF(keyAxis->coordToPixel(it->key), valueAxis->coordToPixel(it->value)));
-      
-      // advance iterator to next (non-skipped) data point:
-      if (!doScatterSkip)
-        ++it;
+      itIndex += scatterModulo;
+      if (itIndex < endIndex) // make sure we didn't jump over end
+        it += scatterModulo;
       else
       {
-        itIndex += scatterModulo;
-        if (itIndex < endIndex) // make sure we didn't jump over end
-          it += scatterModulo;
-        else
-        {
-          it = end;
-          itIndex = endIndex;
-        }
+        it = end;
+        itIndex = endIndex;
       }
     }
   }
+  scatters->resize(keys.size());
+  keyAxis->coordsToPixels(keys.constData(), 1, scatters->data(), scatters->size());
+  valueAxis->coordsToPixels(values.constData(), 1, scatters->data(), scatters->size());
 }
 
 /*! \internal
@@ -23919,16 +25044,19 @@ double QCPCurve::pointDistance(const QPointF &pixelPoint, QCPCurveDataContainer:
   
   // calculate minimum distances to curve data points and find closestData iterator:
   double minDistSqr = (std::numeric_limits<double>::max)();
-  // iterate over found data points and then choose the one with the shortest distance to pos:
+  // transform the data points to pixels in one batch per axis, then choose the one with the shortest distance to pos:
   QCPCurveDataContainer::const_iterator begin = mDataContainer->constBegin();
-  QCPCurveDataContainer::const_iterator end = mDataContainer->constEnd();
-  for (QCPCurveDataContainer::const_iterator it=begin; it!=end; ++it)
+  QVector<QPointF> points(mDataContainer->size());
+  const int stride = int(sizeof(QCPCurveData)/sizeof(double));
+  mKeyAxis.data()->coordsToPixels(&begin->key, stride, points.data(), points.size());
+  mValueAxis.data()->coordsToPixels(&begin->value, stride, points.data(), points.size());
+  for (int i=0; i<points.size(); ++i)
   {
-    const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
+    const double currentDistSqr = QCPVector2D(points.at(i)-pixelPoint).lengthSquared();
     if (currentDistSqr < minDistSqr)
     {
       minDistSqr = currentDistSqr;
-      closestData = it;
+      closestData = begin+i;
     }
   }
   
@@ -24690,9 +25818,10 @@ QCPDataSelection QCPBars::selectTestRect(const QRectF &rect, bool onlySelectable
   QCPBarsDataContainer::const_iterator visibleBegin, visibleEnd;
   getVisibleDataBounds(visibleBegin, visibleEnd);
   
+  const QVector<QRectF> barRects = getBarRects(visibleBegin, visibleEnd);
   for (QCPBarsDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
   {
-    if (rect.intersects(getBarRect(it->key, it->value)))
+    if (rect.intersects(barRects.at(int(it-visibleBegin))))
       result.addDataRange(QCPDataRange(int(it-mDataContainer->constBegin()), int(it-mDataContainer->constBegin()+1)), false);
   }
   result.simplify();
@@ -24720,9 +25849,10 @@ double QCPBars::selectTest(const QPointF &pos, bool onlySelectable, QVariant *de
     // get visible data range:
     QCPBarsDataContainer::const_iterator visibleBegin, visibleEnd;
     getVisibleDataBounds(visibleBegin, visibleEnd);
+    const QVector<QRectF> barRects = getBarRects(visibleBegin, visibleEnd);
     for (QCPBarsDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
     {
-      if (getBarRect(it->key, it->value).contains(pos))
+      if (barRects.at(int(it-visibleBegin)).contains(pos))
       {
         if (details)
         {
@@ -24860,6 +25990,7 @@ void QCPBars::draw(QCPPainter *painter)
     if (begin == end)
       continue;
     
+    const QVector<QRectF> barRects = getBarRects(begin, end);
     for (QCPBarsDataContainer::const_iterator it=begin; it!=end; ++it)
     {
       // check data validity if flag set:
@@ -24878,7 +26009,7 @@ void QCPBars::draw(QCPPainter *painter)
         painter->setPen(mPen);
       }
       applyDefaultAntialiasingHint(painter);
-      painter->drawPolygon(getBarRect(it->key, it->value));
+      painter->drawPolygon(barRects.at(int(it-begin)));
     }
   }
   
@@ -25001,6 +26132,79 @@ QRectF QCPBars::getBarRect(double key, double value) const
   }
 }
 
+/*! \internal
+  
+  Returns the rects in pixel coordinates of the bars from \a begin to \a end-1, as \ref getBarRect
+  would return them one by one. The keys, bar bases and bar tops are transformed to pixels in one
+  batch per axis instead of point by point.
+*/
+QVector<QRectF> QCPBars::getBarRects(QCPBarsDataContainer::const_iterator begin, QCPBarsDataContainer::const_iterator end) const
+{
+  QVector<QRectF> result;
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
+  
+  // collect keys, bases and tops (and the bar edges if the width is given in plot coordinates):
+  const int count = int(end-begin);
+  const bool widthInPlotCoords = mWidthType == wtPlotCoords;
+  QVector<double> keyPixels(count), basePixels(count), valuePixels(count), lowerPixels, upperPixels;
+  if (widthInPlotCoords)
+  {
+    lowerPixels.resize(count);
+    upperPixels.resize(count);
+  }
+  for (int i=0; i<count; ++i)
+  {
+    const QCPBarsData &data = *(begin+i);
+    const double base = getStackedBaseValue(data.key, data.value >= 0);
+    keyPixels[i] = data.key;
+    basePixels[i] = base;
+    valuePixels[i] = base+data.value;
+    if (widthInPlotCoords)
+    {
+      lowerPixels[i] = data.key-mWidth*0.5;
+      upperPixels[i] = data.key+mWidth*0.5;
+    }
+  }
+  keyAxis->coordsToPixels(keyPixels.constData(), keyPixels.data(), count);
+  valueAxis->coordsToPixels(basePixels.constData(), basePixels.data(), count);
+  valueAxis->coordsToPixels(valuePixels.constData(), valuePixels.data(), count);
+  double lowerPixelWidth = 0, upperPixelWidth = 0;
+  if (widthInPlotCoords)
+  {
+    keyAxis->coordsToPixels(lowerPixels.constData(), lowerPixels.data(), count);
+    keyAxis->coordsToPixels(upperPixels.constData(), upperPixels.data(), count);
+  } else
+    getPixelWidth(0, lowerPixelWidth, upperPixelWidth); // other width types don't depend on the key
+  
+  double stackOffset = (mBarBelow && mPen != Qt::NoPen ? 1 : 0)*(mPen.isCosmetic() ? 1 : mPen.widthF());
+  stackOffset += mBarBelow ? mStackingGap : 0;
+  result.resize(count);
+  for (int i=0; i<count; ++i)
+  {
+    const QCPBarsData &data = *(begin+i);
+    double keyPixel = keyPixels.at(i);
+    if (widthInPlotCoords)
+    {
+      lowerPixelWidth = lowerPixels.at(i)-keyPixel;
+      upperPixelWidth = upperPixels.at(i)-keyPixel;
+    }
+    if (mBarsGroup)
+      keyPixel += mBarsGroup->keyPixelOffset(this, data.key);
+    const double basePixel = basePixels.at(i);
+    const double valuePixel = valuePixels.at(i);
+    double bottomOffset = stackOffset*(data.value<0 ? -1 : 1)*valueAxis->pixelOrientation();
+    if (qAbs(valuePixel-basePixel) <= qAbs(bottomOffset))
+      bottomOffset = valuePixel-basePixel;
+    if (keyAxis->orientation() == Qt::Horizontal)
+      result[i] = QRectF(QPointF(keyPixel+lowerPixelWidth, valuePixel), QPointF(keyPixel+upperPixelWidth, basePixel+bottomOffset)).normalized();
+    else
+      result[i] = QRectF(QPointF(basePixel+bottomOffset, keyPixel+lowerPixelWidth), QPointF(valuePixel, keyPixel+upperPixelWidth)).normalized();
+  }
+  return result;
+}
+
 /*! \internal
   
   This function is used to determine the width of the bar at coordinate \a key, according to the
@@ -25314,6 +26518,16 @@ QCPStatisticalBoxData::QCPStatisticalBoxData(double key, double minimum, double
 
 /* end documentation of inline functions */
 
+/*! \internal
+  
+  Returns the pixel point of a box at \a keyPixel and \a valuePixel, i.e. keys in x and values in y
+  for a horizontal key axis (\a keyOrientation), and the other way around for a vertical one.
+*/
+static inline QPointF qcpBoxPoint(double keyPixel, double valuePixel, Qt::Orientation keyOrientation)
+{
+  return keyOrientation == Qt::Horizontal ? QPointF(keyPixel, valuePixel) : QPointF(valuePixel, keyPixel);
+}
+
 /*!
   Constructs a statistical box which uses \a keyAxis as its key axis ("x") and \a valueAxis as its
   value axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and
@@ -25522,9 +26736,15 @@ QCPDataSelection QCPStatisticalBox::selectTestRect(const QRectF &rect, bool only
   QCPStatisticalBoxDataContainer::const_iterator visibleBegin, visibleEnd;
   getVisibleDataBounds(visibleBegin, visibleEnd);
   
+  QVector<double> keyPixels(int(visibleEnd-visibleBegin)*5), valuePixels(keyPixels.size());
+  getBoxPixels(visibleBegin, visibleEnd, keyPixels.data(), valuePixels.data());
+  const Qt::Orientation keyOrientation = mKeyAxis->orientation();
   for (QCPStatisticalBoxDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
   {
-    if (rect.intersects(getQuartileBox(it)))
+    const int i = int(it-visibleBegin)*5;
+    const QRectF quartileBox(qcpBoxPoint(keyPixels.at(i+0), valuePixels.at(i+3), keyOrientation),
+                             qcpBoxPoint(keyPixels.at(i+2), valuePixels.at(i+1), keyOrientation));
+    if (rect.intersects(quartileBox))
       result.addDataRange(QCPDataRange(int(it-mDataContainer->constBegin()), int(it-mDataContainer->constBegin()+1)), false);
   }
   result.simplify();
@@ -25553,10 +26773,16 @@ double QCPStatisticalBox::selectTest(const QPointF &pos, bool onlySelectable, QV
     QCPStatisticalBoxDataContainer::const_iterator visibleBegin, visibleEnd;
     QCPStatisticalBoxDataContainer::const_iterator closestDataPoint = mDataContainer->constEnd();
     getVisibleDataBounds(visibleBegin, visibleEnd);
+    QVector<double> keyPixels(int(visibleEnd-visibleBegin)*5), valuePixels(keyPixels.size());
+    getBoxPixels(visibleBegin, visibleEnd, keyPixels.data(), valuePixels.data());
+    const Qt::Orientation keyOrientation = mKeyAxis->orientation();
     double minDistSqr = (std::numeric_limits<double>::max)();
     for (QCPStatisticalBoxDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
     {
-      if (getQuartileBox(it).contains(pos)) // quartile box
+      const int i = int(it-visibleBegin)*5;
+      const QRectF quartileBox(qcpBoxPoint(keyPixels.at(i+0), valuePixels.at(i+3), keyOrientation),
+                               qcpBoxPoint(keyPixels.at(i+2), valuePixels.at(i+1), keyOrientation));
+      if (quartileBox.contains(pos)) // quartile box
       {
         double currentDistSqr = mParentPlot->selectionTolerance()*0.99 * mParentPlot->selectionTolerance()*0.99;
         if (currentDistSqr < minDistSqr)
@@ -25566,11 +26792,14 @@ double QCPStatisticalBox::selectTest(const QPointF &pos, bool onlySelectable, QV
         }
       } else // whiskers
       {
-        const QVector<QLineF> whiskerBackbones = getWhiskerBackboneLines(it);
+        const QLineF whiskerBackbones[2] = {
+          QLineF(qcpBoxPoint(keyPixels.at(i+1), valuePixels.at(i+1), keyOrientation), qcpBoxPoint(keyPixels.at(i+1), valuePixels.at(i+0), keyOrientation)), // min backbone
+          QLineF(qcpBoxPoint(keyPixels.at(i+1), valuePixels.at(i+3), keyOrientation), qcpBoxPoint(keyPixels.at(i+1), valuePixels.at(i+4), keyOrientation)) // max backbone
+        };
         const QCPVector2D posVec(pos);
-        foreach (const QLineF &backbone, whiskerBackbones)
+        for (int k=0; k<2; ++k)
         {
-          double currentDistSqr = posVec.distanceSquaredToLine(backbone);
+          double currentDistSqr = posVec.distanceSquaredToLine(whiskerBackbones[k]);
           if (currentDistSqr < minDistSqr)
           {
             minDistSqr = currentDistSqr;
@@ -25690,27 +26919,50 @@ void QCPStatisticalBox::drawLegendIcon(QCPPainter *painter, const QRectF &rect)
 */
 void QCPStatisticalBox::drawStatisticalBox(QCPPainter *painter, QCPStatisticalBoxDataContainer::const_iterator it, const QCPScatterStyle &outlierStyle) const
 {
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+  
+  // transform the box geometry to pixels in one batch per axis:
+  double keyPixels[5], valuePixels[5];
+  getBoxPixels(it, it+1, keyPixels, valuePixels);
+  const Qt::Orientation keyOrientation = keyAxis->orientation();
+  
   // draw quartile box:
   applyDefaultAntialiasingHint(painter);
-  const QRectF quartileBox = getQuartileBox(it);
+  const QRectF quartileBox(qcpBoxPoint(keyPixels[0], valuePixels[3], keyOrientation), qcpBoxPoint(keyPixels[2], valuePixels[1], keyOrientation));
   painter->drawRect(quartileBox);
   // draw median line with cliprect set to quartile box:
   painter->save();
   painter->setClipRect(quartileBox, Qt::IntersectClip);
   painter->setPen(mMedianPen);
-  painter->drawLine(QLineF(coordsToPixels(it->key-mWidth*0.5, it->median), coordsToPixels(it->key+mWidth*0.5, it->median)));
+  painter->drawLine(QLineF(qcpBoxPoint(keyPixels[0], valuePixels[2], keyOrientation), qcpBoxPoint(keyPixels[2], valuePixels[2], keyOrientation)));
   painter->restore();
   // draw whisker lines:
   applyAntialiasingHint(painter, mWhiskerAntialiased, QCP::aePlottables);
   painter->setPen(mWhiskerPen);
-  painter->drawLines(getWhiskerBackboneLines(it));
+  const QLineF backbones[2] = {
+    QLineF(qcpBoxPoint(keyPixels[1], valuePixels[1], keyOrientation), qcpBoxPoint(keyPixels[1], valuePixels[0], keyOrientation)), // min backbone
+    QLineF(qcpBoxPoint(keyPixels[1], valuePixels[3], keyOrientation), qcpBoxPoint(keyPixels[1], valuePixels[4], keyOrientation)) // max backbone
+  };
+  painter->drawLines(backbones, 2);
   painter->setPen(mWhiskerBarPen);
-  painter->drawLines(getWhiskerBarLines(it));
+  const QLineF bars[2] = {
+    QLineF(qcpBoxPoint(keyPixels[3], valuePixels[0], keyOrientation), qcpBoxPoint(keyPixels[4], valuePixels[0], keyOrientation)), // min bar
+    QLineF(qcpBoxPoint(keyPixels[3], valuePixels[4], keyOrientation), qcpBoxPoint(keyPixels[4], valuePixels[4], keyOrientation)) // max bar
+  };
+  painter->drawLines(bars, 2);
   // draw outliers:
-  applyScattersAntialiasingHint(painter);
-  outlierStyle.applyTo(painter, mPen);
-  for (int i=0; i<it->outliers.size(); ++i)
-    outlierStyle.drawShape(painter, coordsToPixels(it->key, it->outliers.at(i)));
+  if (!it->outliers.isEmpty())
+  {
+    applyScattersAntialiasingHint(painter);
+    outlierStyle.applyTo(painter, mPen);
+    QVector<QPointF> outlierPoints(it->outliers.size());
+    keyAxis->coordsToPixels(&it->key, 0, outlierPoints.data(), outlierPoints.size()); // stride 0: all outliers share the key
+    valueAxis->coordsToPixels(it->outliers.constData(), 1, outlierPoints.data(), outlierPoints.size());
+    for (int i=0; i<outlierPoints.size(); ++i)
+      outlierStyle.drawShape(painter, outlierPoints.at(i));
+  }
 }
 
 /*!  \internal
@@ -25740,6 +26992,39 @@ void QCPStatisticalBox::getVisibleDataBounds(QCPStatisticalBoxDataContainer::con
   end = mDataContainer->findEnd(mKeyAxis.data()->range().upper+mWidth*0.5); // add half width of box to include partially visible data points
 }
 
+/*!  \internal
+
+  Transforms the geometry of the boxes from \a begin to \a end-1 to pixels, in one batch per axis.
+  \a keyPixels and \a valuePixels must hold five values per box. For box \c i, \a keyPixels
+  receives the key minus and plus half the box width at <tt>5*i+0</tt> and <tt>5*i+2</tt>, the key
+  itself at <tt>5*i+1</tt>, and the key minus and plus half the whisker width at <tt>5*i+3</tt> and
+  <tt>5*i+4</tt>. \a valuePixels receives the minimum, lower quartile, median, upper quartile and
+  maximum, in that order.
+
+  \see drawStatisticalBox
+*/
+void QCPStatisticalBox::getBoxPixels(QCPStatisticalBoxDataContainer::const_iterator begin, QCPStatisticalBoxDataContainer::const_iterator end, double *keyPixels, double *valuePixels) const
+{
+  const int count = int(end-begin)*5;
+  for (QCPStatisticalBoxDataContainer::const_iterator it=begin; it!=end; ++it)
+  {
+    double *keys = keyPixels+int(it-begin)*5;
+    double *values = valuePixels+int(it-begin)*5;
+    keys[0] = it->key-mWidth*0.5;
+    keys[1] = it->key;
+    keys[2] = it->key+mWidth*0.5;
+    keys[3] = it->key-mWhiskerWidth*0.5;
+    keys[4] = it->key+mWhiskerWidth*0.5;
+    values[0] = it->minimum;
+    values[1] = it->lowerQuartile;
+    values[2] = it->median;
+    values[3] = it->upperQuartile;
+    values[4] = it->maximum;
+  }
+  mKeyAxis.data()->coordsToPixels(keyPixels, keyPixels, count);
+  mValueAxis.data()->coordsToPixels(valuePixels, valuePixels, count);
+}
+
 /*!  \internal
 
   Returns the box in plot coordinates (keys in x, values in y of the returned rect) that covers the
@@ -25826,6 +27111,11 @@ QVector<QLineF> QCPStatisticalBox::getWhiskerBarLines(QCPStatisticalBoxDataConta
   true current minimum and maximum. The method QCPColorMap::rescaleDataRange offers a convenience
   parameter \a recalculateDataBounds which may be set to true to automatically call \ref
   recalculateDataBounds internally.
+  
+  The cells changed via \ref setCell, \ref setData and \ref setAlpha are tracked, so the \ref
+  QCPColorMap only colorizes the changed part of its map image at the next replot. For data that
+  grows along the key axis, \ref scrollKey moves the existing cells and the map image along, so
+  only the newly appended columns need to be colorized.
 */
 
 /* start of documentation of inline functions */
@@ -25853,7 +27143,8 @@ QCPColorMapData::QCPColorMapData(int keySize, int valueSize, const QCPRange &key
   mIsEmpty(true),
   mData(nullptr),
   mAlpha(nullptr),
-  mDataModified(true)
+  mDataModified(true),
+  mKeyShift(0)
 {
   setSize(keySize, valueSize);
   fill(0);
@@ -25874,7 +27165,8 @@ QCPColorMapData::QCPColorMapData(const QCPColorMapData &other) :
   mIsEmpty(true),
   mData(nullptr),
   mAlpha(nullptr),
-  mDataModified(true)
+  mDataModified(true),
+  mKeyShift(0)
 {
   *this = other;
 }
@@ -26085,7 +27377,7 @@ void QCPColorMapData::setData(double key, double value, double z)
       mDataBounds.lower = z;
     if (z > mDataBounds.upper)
       mDataBounds.upper = z;
-     mDataModified = true;
+    mModifiedCells |= QRect(keyCell, valueCell, 1, 1);
   }
 }
 
@@ -26109,7 +27401,7 @@ void QCPColorMapData::setCell(int keyIndex, int valueIndex, double z)
       mDataBounds.lower = z;
     if (z > mDataBounds.upper)
       mDataBounds.upper = z;
-     mDataModified = true;
+    mModifiedCells |= QRect(keyIndex, valueIndex, 1, 1);
   } else
     qDebug() << Q_FUNC_INFO << "index out of bounds:" << keyIndex << valueIndex;
 }
@@ -26136,7 +27428,7 @@ void QCPColorMapData::setAlpha(int keyIndex, int valueIndex, unsigned char alpha
     if (mAlpha || createAlpha())
     {
       mAlpha[valueIndex*mKeySize + keyIndex] = alpha;
-      mDataModified = true;
+      mModifiedCells |= QRect(keyIndex, valueIndex, 1, 1);
     }
   } else
     qDebug() << Q_FUNC_INFO << "index out of bounds:" << keyIndex << valueIndex;
@@ -26227,6 +27519,66 @@ void QCPColorMapData::fillAlpha(unsigned char alpha)
   }
 }
 
+/*!
+  Scrolls the data by \a cellCount cells in the key dimension, which is useful for maps that grow
+  continuously along the key axis, e.g. spectrograms over time.
+
+  For positive \a cellCount, the first \a cellCount key columns are dropped, the remaining columns
+  move to lower key indices, and the key range (\ref setKeyRange) is moved up by the same number of
+  cells, so the retained cells keep their plot coordinates. The \a cellCount columns at the end are
+  set to 0 (and full opacity, if an alpha map exists) and can then be filled with the new data via
+  \ref setCell. Negative values of \a cellCount scroll in the other direction.
+
+  The \ref QCPColorMap showing this data then shifts its buffered map image accordingly and only
+  needs to colorize the new columns (and other cells changed in the meantime), instead of the whole
+  map.
+
+  As with \ref setCell, the buffered data bounds are not shrunk by dropping columns, see \ref
+  recalculateDataBounds.
+*/
+void QCPColorMapData::scrollKey(int cellCount)
+{
+  if (mIsEmpty || !mData || cellCount == 0)
+    return;
+  
+  const double cellWidth = mKeySize > 1 ? (mKeyRange.upper-mKeyRange.lower)/double(mKeySize-1) : 0;
+  mKeyRange.lower += cellCount*cellWidth;
+  mKeyRange.upper += cellCount*cellWidth;
+  if (qAbs(cellCount) >= mKeySize) // nothing is retained
+  {
+    fill(0);
+    if (mAlpha)
+      fillAlpha(255);
+    return;
+  }
+  
+  const int retained = mKeySize-qAbs(cellCount);
+  const int sourceIndex = cellCount > 0 ? cellCount : 0;
+  const int targetIndex = cellCount > 0 ? 0 : -cellCount;
+  const int newIndex = cellCount > 0 ? retained : 0; // first of the columns that become free
+  for (int valueIndex=0; valueIndex<mValueSize; ++valueIndex)
+  {
+    double *row = mData+valueIndex*mKeySize;
+    memmove(row+targetIndex, row+sourceIndex, sizeof(*mData)*size_t(retained));
+    std::fill(row+newIndex, row+newIndex+qAbs(cellCount), 0.0);
+    if (mAlpha)
+    {
+      unsigned char *alphaRow = mAlpha+valueIndex*mKeySize;
+      memmove(alphaRow+targetIndex, alphaRow+sourceIndex, sizeof(*mAlpha)*size_t(retained));
+      memset(alphaRow+newIndex, 255, sizeof(*mAlpha)*size_t(qAbs(cellCount)));
+    }
+  }
+  if (mDataBounds.lower > 0)
+    mDataBounds.lower = 0;
+  if (mDataBounds.upper < 0)
+    mDataBounds.upper = 0;
+  
+  // the map image is shifted by the same amount, so only cells that were changed individually and the new columns need colorizing:
+  mModifiedCells = mModifiedCells.translated(-cellCount, 0) & QRect(0, 0, mKeySize, mValueSize);
+  mModifiedCells |= QRect(newIndex, 0, qAbs(cellCount), mValueSize);
+  mKeyShift += cellCount;
+}
+
 /*!
   Transforms plot coordinates given by \a key and \a value to cell indices of this QCPColorMapData
   instance. The resulting cell indices are returned via the output parameters \a keyIndex and \a
@@ -26737,6 +28089,36 @@ QCPRange QCPColorMap::getValueRange(bool &foundRange, QCP::SignDomain inSignDoma
   return result;
 }
 
+/*! \internal
+
+  \brief Colorizes a band of cells of a QCPColorMap on a thread of a QThreadPool
+
+  Used by \ref QCPColorMap::updateMapImage for large updates. \a done is released once the band
+  was colorized.
+*/
+class QCPColorMapColorizeTask : public QRunnable
+{
+public:
+  QCPColorMapColorizeTask(QCPColorMap *colorMap, QImage *image, const QRect &cells, QSemaphore *done) :
+    mColorMap(colorMap),
+    mImage(image),
+    mCells(cells),
+    mDone(done)
+  {}
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    mColorMap->colorizeCells(mImage, mCells);
+    mDone->release();
+  }
+  
+private:
+  QCPColorMap *mColorMap;
+  QImage *mImage;
+  QRect mCells;
+  QSemaphore *mDone;
+};
+
 /*! \internal
   
   Updates the internal map image buffer by going through the internal \ref QCPColorMapData and
@@ -26763,11 +28145,19 @@ void QCPColorMap::updateMapImage()
   int keyOversamplingFactor = mInterpolate ? 1 : int(1.0+100.0/double(keySize)); // make mMapImage have at least size 100, factor becomes 1 if size > 200 or interpolation is on
   int valueOversamplingFactor = mInterpolate ? 1 : int(1.0+100.0/double(valueSize)); // make mMapImage have at least size 100, factor becomes 1 if size > 200 or interpolation is on
   
+  // only cells that were changed individually need to be colorized, unless the whole map or the image changed:
+  bool fullUpdate = mMapData->mDataModified || mMapImageInvalidated;
+  
   // resize mMapImage to correct dimensions including possible oversampling factors, according to key/value axes orientation:
   if (keyAxis->orientation() == Qt::Horizontal && (mMapImage.width() != keySize*keyOversamplingFactor || mMapImage.height() != valueSize*valueOversamplingFactor))
+  {
     mMapImage = QImage(QSize(keySize*keyOversamplingFactor, valueSize*valueOversamplingFactor), format);
-  else if (keyAxis->orientation() == Qt::Vertical && (mMapImage.width() != valueSize*valueOversamplingFactor || mMapImage.height() != keySize*keyOversamplingFactor))
+    fullUpdate = true;
+  } else if (keyAxis->orientation() == Qt::Vertical && (mMapImage.width() != valueSize*valueOversamplingFactor || mMapImage.height() != keySize*keyOversamplingFactor))
+  {
     mMapImage = QImage(QSize(valueSize*valueOversamplingFactor, keySize*keyOversamplingFactor), format);
+    fullUpdate = true;
+  }
   
   if (mMapImage.isNull())
   {
@@ -26781,39 +28171,61 @@ void QCPColorMap::updateMapImage()
     {
       // resize undersampled map image to actual key/value cell sizes:
       if (keyAxis->orientation() == Qt::Horizontal && (mUndersampledMapImage.width() != keySize || mUndersampledMapImage.height() != valueSize))
+      {
         mUndersampledMapImage = QImage(QSize(keySize, valueSize), format);
-      else if (keyAxis->orientation() == Qt::Vertical && (mUndersampledMapImage.width() != valueSize || mUndersampledMapImage.height() != keySize))
+        fullUpdate = true;
+      } else if (keyAxis->orientation() == Qt::Vertical && (mUndersampledMapImage.width() != valueSize || mUndersampledMapImage.height() != keySize))
+      {
         mUndersampledMapImage = QImage(QSize(valueSize, keySize), format);
+        fullUpdate = true;
+      }
       localMapImage = &mUndersampledMapImage; // make the colorization run on the undersampled image
     } else if (!mUndersampledMapImage.isNull())
       mUndersampledMapImage = QImage(); // don't need oversampling mechanism anymore (map size has changed) but mUndersampledMapImage still has nonzero size, free it
     
-    const double *rawData = mMapData->mData;
-    const unsigned char *rawAlpha = mMapData->mAlpha;
-    if (keyAxis->orientation() == Qt::Horizontal)
+    // if the data was scrolled (QCPColorMapData::scrollKey), shift the already colorized pixels along:
+    const int keyShift = mMapData->mKeyShift;
+    if (!fullUpdate && keyShift != 0)
     {
-      const int lineCount = valueSize;
-      const int rowCount = keySize;
-      for (int line=0; line<lineCount; ++line)
-      {
-        QRgb* pixels = reinterpret_cast<QRgb*>(localMapImage->scanLine(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
-        if (rawAlpha)
-          mGradient.colorize(rawData+line*rowCount, rawAlpha+line*rowCount, mDataRange, pixels, rowCount, 1, mDataScaleType==QCPAxis::stLogarithmic);
-        else
-          mGradient.colorize(rawData+line*rowCount, mDataRange, pixels, rowCount, 1, mDataScaleType==QCPAxis::stLogarithmic);
-      }
-    } else // keyAxis->orientation() == Qt::Vertical
-    {
-      const int lineCount = keySize;
-      const int rowCount = valueSize;
-      for (int line=0; line<lineCount; ++line)
+      if (qAbs(keyShift) >= keySize)
+        fullUpdate = true;
+      else
+        shiftMapImage(localMapImage, keyShift);
+    }
+    
+    QRect cells(0, 0, keySize, valueSize); // x is key index, y is value index
+    if (!fullUpdate)
+      cells &= mMapData->mModifiedCells;
+    
+    if (!cells.isEmpty())
+    {
+      // large updates are split into bands of lines that are colorized in parallel on the plot's thread pool. Not done
+      // if we are already running on a pool thread (QCP::phParallelLayers), waiting for more pool tasks there could stall the pool:
+      const bool horizontal = keyAxis->orientation() == Qt::Horizontal;
+      const int lineBegin = horizontal ? cells.top() : cells.left();
+      const int lineCount = horizontal ? cells.height() : cells.width();
+      QThreadPool *threadPool = mParentPlot->threadPool();
+      const int bandCount = qMin(lineCount, threadPool->maxThreadCount());
+      if (bandCount > 1 && cells.width()*cells.height() >= 256*256 && QThread::currentThread() == thread())
       {
-        QRgb* pixels = reinterpret_cast<QRgb*>(localMapImage->scanLine(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
-        if (rawAlpha)
-          mGradient.colorize(rawData+line, rawAlpha+line, mDataRange, pixels, rowCount, lineCount, mDataScaleType==QCPAxis::stLogarithmic);
-        else
-          mGradient.colorize(rawData+line, mDataRange, pixels, rowCount, lineCount, mDataScaleType==QCPAxis::stLogarithmic);
-      }
+        mGradient.color(mDataRange.lower, mDataRange); // makes sure the color buffer of the gradient is up to date before it is used concurrently
+        localMapImage->bits(); // detach here, so the concurrent scanLine calls don't
+        QSemaphore bandsDone;
+        int bandTasks = 0;
+        for (int band=1; band<bandCount; ++band)
+        {
+          const int bandBegin = lineBegin+qint64(lineCount)*band/bandCount;
+          const int bandEnd = lineBegin+qint64(lineCount)*(band+1)/bandCount;
+          const QRect bandCells = horizontal ? QRect(cells.left(), bandBegin, cells.width(), bandEnd-bandBegin) : QRect(bandBegin, cells.top(), bandEnd-bandBegin, cells.height());
+          threadPool->start(new QCPColorMapColorizeTask(this, localMapImage, bandCells, &bandsDone));
+          ++bandTasks;
+        }
+        // the first band is done here while the tasks run:
+        const int firstBandEnd = lineBegin+lineCount/bandCount;
+        colorizeCells(localMapImage, horizontal ? QRect(cells.left(), lineBegin, cells.width(), firstBandEnd-lineBegin) : QRect(lineBegin, cells.top(), firstBandEnd-lineBegin, cells.height()));
+        bandsDone.acquire(bandTasks);
+      } else
+        colorizeCells(localMapImage, cells);
     }
     
     if (keyOversamplingFactor > 1 || valueOversamplingFactor > 1)
@@ -26825,9 +28237,85 @@ void QCPColorMap::updateMapImage()
     }
   }
   mMapData->mDataModified = false;
+  mMapData->mModifiedCells = QRect();
+  mMapData->mKeyShift = 0;
   mMapImageInvalidated = false;
 }
 
+/*! \internal
+  
+  Colorizes the \a cells (x is the key index, y the value index) of the map data into the
+  corresponding pixels of \a image, which has one pixel per cell in the layout of \ref
+  updateMapImage.
+  
+  This may be called concurrently for disjoint \a cells, once the color buffer of the gradient is
+  up to date (see \ref updateMapImage).
+*/
+void QCPColorMap::colorizeCells(QImage *image, const QRect &cells)
+{
+  const int keySize = mMapData->keySize();
+  const int valueSize = mMapData->valueSize();
+  const double *rawData = mMapData->mData;
+  const unsigned char *rawAlpha = mMapData->mAlpha;
+  const bool logarithmic = mDataScaleType == QCPAxis::stLogarithmic;
+  if (mKeyAxis->orientation() == Qt::Horizontal)
+  {
+    const int lineCount = valueSize;
+    const int rowCount = keySize;
+    for (int line=cells.top(); line<=cells.bottom(); ++line)
+    {
+      QRgb* pixels = reinterpret_cast<QRgb*>(image->scanLine(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+      const int dataIndex = line*rowCount+cells.left();
+      if (rawAlpha)
+        mGradient.colorize(rawData+dataIndex, rawAlpha+dataIndex, mDataRange, pixels+cells.left(), cells.width(), 1, logarithmic);
+      else
+        mGradient.colorize(rawData+dataIndex, mDataRange, pixels+cells.left(), cells.width(), 1, logarithmic);
+    }
+  } else // keyAxis->orientation() == Qt::Vertical
+  {
+    const int lineCount = keySize;
+    for (int line=cells.left(); line<=cells.right(); ++line)
+    {
+      QRgb* pixels = reinterpret_cast<QRgb*>(image->scanLine(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+      const int dataIndex = line+cells.top()*lineCount;
+      if (rawAlpha)
+        mGradient.colorize(rawData+dataIndex, rawAlpha+dataIndex, mDataRange, pixels+cells.top(), cells.height(), lineCount, logarithmic);
+      else
+        mGradient.colorize(rawData+dataIndex, mDataRange, pixels+cells.top(), cells.height(), lineCount, logarithmic);
+    }
+  }
+}
+
+/*! \internal
+  
+  Shifts the pixels of the colorized \a image (which has one pixel per cell, in the layout of \ref
+  updateMapImage) by \a keyShift cells towards lower key indices, following a call of \ref
+  QCPColorMapData::scrollKey. The pixels of the cells that become free keep undefined contents, they
+  are colorized afterwards.
+*/
+void QCPColorMap::shiftMapImage(QImage *image, int keyShift) const
+{
+  const int retained = (mKeyAxis->orientation() == Qt::Horizontal ? image->width() : image->height())-qAbs(keyShift);
+  if (retained <= 0)
+    return;
+  if (mKeyAxis->orientation() == Qt::Horizontal) // key index is the pixel column
+  {
+    const int sourceColumn = keyShift > 0 ? keyShift : 0;
+    const int targetColumn = keyShift > 0 ? 0 : -keyShift;
+    for (int line=0; line<image->height(); ++line)
+    {
+      QRgb *pixels = reinterpret_cast<QRgb*>(image->scanLine(line));
+      memmove(pixels+targetColumn, pixels+sourceColumn, sizeof(QRgb)*size_t(retained));
+    }
+  } else // key index is the inverted scanline index, scanlines are contiguous so all retained lines are moved at once
+  {
+    const int sourceLine = keyShift > 0 ? 0 : -keyShift;
+    const int targetLine = keyShift > 0 ? keyShift : 0;
+    uchar *bits = image->bits();
+    memmove(bits+targetLine*image->bytesPerLine(), bits+sourceLine*image->bytesPerLine(), size_t(retained*image->bytesPerLine()));
+  }
+}
+
 /* inherits documentation from base class */
 void QCPColorMap::draw(QCPPainter *painter)
 {
@@ -26835,7 +28323,7 @@ void QCPColorMap::draw(QCPPainter *painter)
   if (!mKeyAxis || !mValueAxis) return;
   applyDefaultAntialiasingHint(painter);
   
-  if (mMapData->mDataModified || mMapImageInvalidated)
+  if (mMapData->mDataModified || !mMapData->mModifiedCells.isEmpty() || mMapData->mKeyShift != 0 || mMapImageInvalidated)
     updateMapImage();
   
   // use buffer if painting vectorized (PDF):
@@ -27316,9 +28804,10 @@ QCPDataSelection QCPFinancial::selectTestRect(const QRectF &rect, bool onlySelec
   QCPFinancialDataContainer::const_iterator visibleBegin, visibleEnd;
   getVisibleDataBounds(visibleBegin, visibleEnd);
   
+  const QVector<QRectF> hitBoxes = selectionHitBoxes(visibleBegin, visibleEnd);
   for (QCPFinancialDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
   {
-    if (rect.intersects(selectionHitBox(it)))
+    if (rect.intersects(hitBoxes.at(int(it-visibleBegin))))
       result.addDataRange(QCPDataRange(int(it-mDataContainer->constBegin()), int(it-mDataContainer->constBegin()+1)), false);
   }
   result.simplify();
@@ -27547,6 +29036,8 @@ void QCPFinancial::drawOhlcPlot(QCPPainter *painter, const QCPFinancialDataConta
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
   
+  QVector<double> keyPixels, widthPixels, valuePixels;
+  getOhlcPixels(begin, end, keyPixels, widthPixels, valuePixels);
   if (keyAxis->orientation() == Qt::Horizontal)
   {
     for (QCPFinancialDataContainer::const_iterator it = begin; it != end; ++it)
@@ -27557,13 +29048,14 @@ void QCPFinancial::drawOhlcPlot(QCPPainter *painter, const QCPFinancialDataConta
         painter->setPen(it->close >= it->open ? mPenPositive : mPenNegative);
       else
         painter->setPen(mPen);
-      double keyPixel = keyAxis->coordToPixel(it->key);
-      double openPixel = valueAxis->coordToPixel(it->open);
-      double closePixel = valueAxis->coordToPixel(it->close);
+      const int i = int(it-begin);
+      double keyPixel = keyPixels.at(i);
+      double openPixel = valuePixels.at(i*4+0);
+      double closePixel = valuePixels.at(i*4+3);
       // draw backbone:
-      painter->drawLine(QPointF(keyPixel, valueAxis->coordToPixel(it->high)), QPointF(keyPixel, valueAxis->coordToPixel(it->low)));
+      painter->drawLine(QPointF(keyPixel, valuePixels.at(i*4+1)), QPointF(keyPixel, valuePixels.at(i*4+2)));
       // draw open:
-      double pixelWidth = getPixelWidth(it->key, keyPixel); // sign of this makes sure open/close are on correct sides
+      double pixelWidth = widthPixels.at(i); // sign of this makes sure open/close are on correct sides
       painter->drawLine(QPointF(keyPixel-pixelWidth, openPixel), QPointF(keyPixel, openPixel));
       // draw close:
       painter->drawLine(QPointF(keyPixel, closePixel), QPointF(keyPixel+pixelWidth, closePixel));
@@ -27578,13 +29070,14 @@ void QCPFinancial::drawOhlcPlot(QCPPainter *painter, const QCPFinancialDataConta
         painter->setPen(it->close >= it->open ? mPenPositive : mPenNegative);
       else
         painter->setPen(mPen);
-      double keyPixel = keyAxis->coordToPixel(it->key);
-      double openPixel = valueAxis->coordToPixel(it->open);
-      double closePixel = valueAxis->coordToPixel(it->close);
+      const int i = int(it-begin);
+      double keyPixel = keyPixels.at(i);
+      double openPixel = valuePixels.at(i*4+0);
+      double closePixel = valuePixels.at(i*4+3);
       // draw backbone:
-      painter->drawLine(QPointF(valueAxis->coordToPixel(it->high), keyPixel), QPointF(valueAxis->coordToPixel(it->low), keyPixel));
+      painter->drawLine(QPointF(valuePixels.at(i*4+1), keyPixel), QPointF(valuePixels.at(i*4+2), keyPixel));
       // draw open:
-      double pixelWidth = getPixelWidth(it->key, keyPixel); // sign of this makes sure open/close are on correct sides
+      double pixelWidth = widthPixels.at(i); // sign of this makes sure open/close are on correct sides
       painter->drawLine(QPointF(openPixel, keyPixel-pixelWidth), QPointF(openPixel, keyPixel));
       // draw close:
       painter->drawLine(QPointF(closePixel, keyPixel), QPointF(closePixel, keyPixel+pixelWidth));
@@ -27604,6 +29097,8 @@ void QCPFinancial::drawCandlestickPlot(QCPPainter *painter, const QCPFinancialDa
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
   
+  QVector<double> keyPixels, widthPixels, valuePixels;
+  getOhlcPixels(begin, end, keyPixels, widthPixels, valuePixels);
   if (keyAxis->orientation() == Qt::Horizontal)
   {
     for (QCPFinancialDataContainer::const_iterator it = begin; it != end; ++it)
@@ -27621,15 +29116,16 @@ void QCPFinancial::drawCandlestickPlot(QCPPainter *painter, const QCPFinancialDa
         painter->setPen(mPen);
         painter->setBrush(mBrush);
       }
-      double keyPixel = keyAxis->coordToPixel(it->key);
-      double openPixel = valueAxis->coordToPixel(it->open);
-      double closePixel = valueAxis->coordToPixel(it->close);
+      const int i = int(it-begin);
+      double keyPixel = keyPixels.at(i);
+      double openPixel = valuePixels.at(i*4+0);
+      double closePixel = valuePixels.at(i*4+3);
       // draw high:
-      painter->drawLine(QPointF(keyPixel, valueAxis->coordToPixel(it->high)), QPointF(keyPixel, valueAxis->coordToPixel(qMax(it->open, it->close))));
+      painter->drawLine(QPointF(keyPixel, valuePixels.at(i*4+1)), QPointF(keyPixel, it->open >= it->close ? openPixel : closePixel));
       // draw low:
-      painter->drawLine(QPointF(keyPixel, valueAxis->coordToPixel(it->low)), QPointF(keyPixel, valueAxis->coordToPixel(qMin(it->open, it->close))));
+      painter->drawLine(QPointF(keyPixel, valuePixels.at(i*4+2)), QPointF(keyPixel, it->open < it->close ? openPixel : closePixel));
       // draw open-close box:
-      double pixelWidth = getPixelWidth(it->key, keyPixel);
+      double pixelWidth = widthPixels.at(i);
       painter->drawRect(QRectF(QPointF(keyPixel-pixelWidth, closePixel), QPointF(keyPixel+pixelWidth, openPixel)));
     }
   } else // keyAxis->orientation() == Qt::Vertical
@@ -27649,15 +29145,16 @@ void QCPFinancial::drawCandlestickPlot(QCPPainter *painter, const QCPFinancialDa
         painter->setPen(mPen);
         painter->setBrush(mBrush);
       }
-      double keyPixel = keyAxis->coordToPixel(it->key);
-      double openPixel = valueAxis->coordToPixel(it->open);
-      double closePixel = valueAxis->coordToPixel(it->close);
+      const int i = int(it-begin);
+      double keyPixel = keyPixels.at(i);
+      double openPixel = valuePixels.at(i*4+0);
+      double closePixel = valuePixels.at(i*4+3);
       // draw high:
-      painter->drawLine(QPointF(valueAxis->coordToPixel(it->high), keyPixel), QPointF(valueAxis->coordToPixel(qMax(it->open, it->close)), keyPixel));
+      painter->drawLine(QPointF(valuePixels.at(i*4+1), keyPixel), QPointF(it->open >= it->close ? openPixel : closePixel, keyPixel));
       // draw low:
-      painter->drawLine(QPointF(valueAxis->coordToPixel(it->low), keyPixel), QPointF(valueAxis->coordToPixel(qMin(it->open, it->close)), keyPixel));
+      painter->drawLine(QPointF(valuePixels.at(i*4+2), keyPixel), QPointF(it->open < it->close ? openPixel : closePixel, keyPixel));
       // draw open-close box:
-      double pixelWidth = getPixelWidth(it->key, keyPixel);
+      double pixelWidth = widthPixels.at(i);
       painter->drawRect(QRectF(QPointF(closePixel, keyPixel-pixelWidth), QPointF(openPixel, keyPixel+pixelWidth)));
     }
   }
@@ -27710,6 +29207,44 @@ double QCPFinancial::getPixelWidth(double key, double keyPixel) const
   return result;
 }
 
+/*! \internal
+
+  Transforms the data points from \a begin to \a end-1 to pixels, in one batch per axis instead of
+  point by point. \a keyPixels receives the key pixel of each data point, \a widthPixels the
+  corresponding \ref getPixelWidth, and \a valuePixels four values per data point: open, high, low
+  and close.
+
+  This method is a helper function for the drawing and selection test methods.
+*/
+void QCPFinancial::getOhlcPixels(const QCPFinancialDataContainer::const_iterator &begin, const QCPFinancialDataContainer::const_iterator &end, QVector<double> &keyPixels, QVector<double> &widthPixels, QVector<double> &valuePixels) const
+{
+  const int count = int(end-begin);
+  keyPixels.resize(count);
+  widthPixels.resize(count);
+  valuePixels.resize(count*4);
+  const bool widthInPlotCoords = mWidthType == wtPlotCoords;
+  for (int i=0; i<count; ++i)
+  {
+    const QCPFinancialData &data = *(begin+i);
+    keyPixels[i] = data.key;
+    if (widthInPlotCoords)
+      widthPixels[i] = data.key+mWidth*0.5;
+    valuePixels[i*4+0] = data.open;
+    valuePixels[i*4+1] = data.high;
+    valuePixels[i*4+2] = data.low;
+    valuePixels[i*4+3] = data.close;
+  }
+  mKeyAxis.data()->coordsToPixels(keyPixels.constData(), keyPixels.data(), count);
+  mValueAxis.data()->coordsToPixels(valuePixels.constData(), valuePixels.data(), valuePixels.size());
+  if (widthInPlotCoords)
+  {
+    mKeyAxis.data()->coordsToPixels(widthPixels.constData(), widthPixels.data(), count);
+    for (int i=0; i<count; ++i)
+      widthPixels[i] -= keyPixels.at(i);
+  } else if (count > 0)
+    widthPixels.fill(getPixelWidth(begin->key, keyPixels.first())); // other width types don't depend on the key
+}
+
 /*! \internal
 
   This method is a helper function for \ref selectTest. It is used to test for selection when the
@@ -27725,14 +29260,17 @@ double QCPFinancial::ohlcSelectTest(const QPointF &pos, const QCPFinancialDataCo
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return -1; }
 
+  QVector<double> keyPixels, widthPixels, valuePixels;
+  getOhlcPixels(begin, end, keyPixels, widthPixels, valuePixels);
   double minDistSqr = (std::numeric_limits<double>::max)();
   if (keyAxis->orientation() == Qt::Horizontal)
   {
     for (QCPFinancialDataContainer::const_iterator it=begin; it!=end; ++it)
     {
-      double keyPixel = keyAxis->coordToPixel(it->key);
+      const int i = int(it-begin);
+      double keyPixel = keyPixels.at(i);
       // calculate distance to backbone:
-      double currentDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(keyPixel, valueAxis->coordToPixel(it->high)), QCPVector2D(keyPixel, valueAxis->coordToPixel(it->low)));
+      double currentDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(keyPixel, valuePixels.at(i*4+1)), QCPVector2D(keyPixel, valuePixels.at(i*4+2)));
       if (currentDistSqr < minDistSqr)
       {
         minDistSqr = currentDistSqr;
@@ -27743,9 +29281,10 @@ double QCPFinancial::ohlcSelectTest(const QPointF &pos, const QCPFinancialDataCo
   {
     for (QCPFinancialDataContainer::const_iterator it=begin; it!=end; ++it)
     {
-      double keyPixel = keyAxis->coordToPixel(it->key);
+      const int i = int(it-begin);
+      double keyPixel = keyPixels.at(i);
       // calculate distance to backbone:
-      double currentDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(valueAxis->coordToPixel(it->high), keyPixel), QCPVector2D(valueAxis->coordToPixel(it->low), keyPixel));
+      double currentDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(valuePixels.at(i*4+1), keyPixel), QCPVector2D(valuePixels.at(i*4+2), keyPixel));
       if (currentDistSqr < minDistSqr)
       {
         minDistSqr = currentDistSqr;
@@ -27772,6 +29311,10 @@ double QCPFinancial::candlestickSelectTest(const QPointF &pos, const QCPFinancia
   QCPAxis *valueAxis = mValueAxis.data();
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return -1; }
 
+  QVector<double> keyPixels, widthPixels, valuePixels;
+  getOhlcPixels(begin, end, keyPixels, widthPixels, valuePixels);
+  double posKey, posValue;
+  pixelsToCoords(pos, posKey, posValue);
   double minDistSqr = (std::numeric_limits<double>::max)();
   if (keyAxis->orientation() == Qt::Horizontal)
   {
@@ -27781,17 +29324,18 @@ double QCPFinancial::candlestickSelectTest(const QPointF &pos, const QCPFinancia
       // determine whether pos is in open-close-box:
       QCPRange boxKeyRange(it->key-mWidth*0.5, it->key+mWidth*0.5);
       QCPRange boxValueRange(it->close, it->open);
-      double posKey, posValue;
-      pixelsToCoords(pos, posKey, posValue);
       if (boxKeyRange.contains(posKey) && boxValueRange.contains(posValue)) // is in open-close-box
       {
         currentDistSqr = mParentPlot->selectionTolerance()*0.99 * mParentPlot->selectionTolerance()*0.99;
       } else
       {
         // calculate distance to high/low lines:
-        double keyPixel = keyAxis->coordToPixel(it->key);
-        double highLineDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(keyPixel, valueAxis->coordToPixel(it->high)), QCPVector2D(keyPixel, valueAxis->coordToPixel(qMax(it->open, it->close))));
-        double lowLineDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(keyPixel, valueAxis->coordToPixel(it->low)), QCPVector2D(keyPixel, valueAxis->coordToPixel(qMin(it->open, it->close))));
+        const int i = int(it-begin);
+        double keyPixel = keyPixels.at(i);
+        double openPixel = valuePixels.at(i*4+0);
+        double closePixel = valuePixels.at(i*4+3);
+        double highLineDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(keyPixel, valuePixels.at(i*4+1)), QCPVector2D(keyPixel, it->open >= it->close ? openPixel : closePixel));
+        double lowLineDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(keyPixel, valuePixels.at(i*4+2)), QCPVector2D(keyPixel, it->open < it->close ? openPixel : closePixel));
         currentDistSqr = qMin(highLineDistSqr, lowLineDistSqr);
       }
       if (currentDistSqr < minDistSqr)
@@ -27808,17 +29352,18 @@ double QCPFinancial::candlestickSelectTest(const QPointF &pos, const QCPFinancia
       // determine whether pos is in open-close-box:
       QCPRange boxKeyRange(it->key-mWidth*0.5, it->key+mWidth*0.5);
       QCPRange boxValueRange(it->close, it->open);
-      double posKey, posValue;
-      pixelsToCoords(pos, posKey, posValue);
       if (boxKeyRange.contains(posKey) && boxValueRange.contains(posValue)) // is in open-close-box
       {
         currentDistSqr = mParentPlot->selectionTolerance()*0.99 * mParentPlot->selectionTolerance()*0.99;
       } else
       {
         // calculate distance to high/low lines:
-        double keyPixel = keyAxis->coordToPixel(it->key);
-        double highLineDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(valueAxis->coordToPixel(it->high), keyPixel), QCPVector2D(valueAxis->coordToPixel(qMax(it->open, it->close)), keyPixel));
-        double lowLineDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(valueAxis->coordToPixel(it->low), keyPixel), QCPVector2D(valueAxis->coordToPixel(qMin(it->open, it->close)), keyPixel));
+        const int i = int(it-begin);
+        double keyPixel = keyPixels.at(i);
+        double openPixel = valuePixels.at(i*4+0);
+        double closePixel = valuePixels.at(i*4+3);
+        double highLineDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(valuePixels.at(i*4+1), keyPixel), QCPVector2D(it->open >= it->close ? openPixel : closePixel, keyPixel));
+        double lowLineDistSqr = QCPVector2D(pos).distanceSquaredToLine(QCPVector2D(valuePixels.at(i*4+2), keyPixel), QCPVector2D(it->open < it->close ? openPixel : closePixel, keyPixel));
         currentDistSqr = qMin(highLineDistSqr, lowLineDistSqr);
       }
       if (currentDistSqr < minDistSqr)
@@ -27878,6 +29423,48 @@ QRectF QCPFinancial::selectionHitBox(QCPFinancialDataContainer::const_iterator i
   else
     return QRectF(highPixel, keyPixel-keyWidthPixels, lowPixel-highPixel, keyWidthPixels*2).normalized();
 }
+
+/*!  \internal
+
+  Returns the hit boxes of the data points from \a begin to \a end-1, as \ref selectionHitBox
+  would return them one by one. The keys, box edges, highs and lows are transformed to pixels in
+  one batch per axis.
+*/
+QVector<QRectF> QCPFinancial::selectionHitBoxes(const QCPFinancialDataContainer::const_iterator &begin, const QCPFinancialDataContainer::const_iterator &end) const
+{
+  QVector<QRectF> result;
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
+  
+  const int count = int(end-begin);
+  QVector<double> keyPixels(count), edgePixels(count), highPixels(count), lowPixels(count);
+  for (int i=0; i<count; ++i)
+  {
+    const QCPFinancialData &data = *(begin+i);
+    keyPixels[i] = data.key;
+    edgePixels[i] = data.key-mWidth*0.5;
+    highPixels[i] = data.high;
+    lowPixels[i] = data.low;
+  }
+  keyAxis->coordsToPixels(keyPixels.constData(), keyPixels.data(), count);
+  keyAxis->coordsToPixels(edgePixels.constData(), edgePixels.data(), count);
+  valueAxis->coordsToPixels(highPixels.constData(), highPixels.data(), count);
+  valueAxis->coordsToPixels(lowPixels.constData(), lowPixels.data(), count);
+  result.resize(count);
+  for (int i=0; i<count; ++i)
+  {
+    const double keyPixel = keyPixels.at(i);
+    const double highPixel = highPixels.at(i);
+    const double lowPixel = lowPixels.at(i);
+    const double keyWidthPixels = keyPixel-edgePixels.at(i);
+    if (keyAxis->orientation() == Qt::Horizontal)
+      result[i] = QRectF(keyPixel-keyWidthPixels, highPixel, keyWidthPixels*2, lowPixel-highPixel).normalized();
+    else
+      result[i] = QRectF(highPixel, keyPixel-keyWidthPixels, lowPixel-highPixel, keyWidthPixels*2).normalized();
+  }
+  return result;
+}
 /* end of 'src/plottables/plottable-financial.cpp' */
 
 
@@ -47,6 +47,15 @@
 #  endif
 #endif
 
+// SSE2 kernels for the data hot paths (always available on x86-64), define QCUSTOMPLOT_NO_SIMD to use the scalar code only:
+#if !defined(QCUSTOMPLOT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define QCP_SIMD_SSE2
+#endif
+// wider AVX2 variants of some of them, if the compiler targets AVX2 (e.g. -mavx2 or /arch:AVX2). There is no run time dispatch:
+#if defined(QCP_SIMD_SSE2) && defined(__AVX2__)
+#  define QCP_SIMD_AVX2
+#endif
+
 #include <QtCore/QObject>
 #include <QtCore/QPointer>
 #include <QtCore/QSharedPointer>
@@ -66,6 +75,10 @@
 #include <QtCore/QStack>
 #include <QtCore/QCache>
 #include <QtCore/QMargins>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
 #include <qmath.h>
 #include <limits>
 #include <algorithm>
@@ -268,6 +281,8 @@ enum PlottingHint { phNone              = 0x000 ///< <tt>0x000</tt> No hints are
                     ,phImmediateRefresh = 0x002 ///< <tt>0x002</tt> causes an immediate repaint() instead of a soft update() when QCustomPlot::replot() is called with parameter \ref QCustomPlot::rpRefreshHint.
                                                 ///<                This is set by default to prevent the plot from freezing on fast consecutive replots (e.g. user drags ranges with mouse).
                     ,phCacheLabels      = 0x004 ///< <tt>0x004</tt> axis (tick) labels will be cached as pixmaps, increasing replot performance.
+                    ,phParallelLayers   = 0x008 ///< <tt>0x008</tt> layers in mode \ref QCPLayer::lmBuffered are drawn into their paint buffers in parallel on the plot's thread pool (\ref QCustomPlot::threadPool), see \ref QCustomPlot::setPlottingHints.
+                                                ///<                Has no effect when OpenGL is used.
                   };
 Q_DECLARE_FLAGS(PlottingHints, PlottingHint)
 
@@ -592,6 +607,7 @@ public:
   virtual void donePainting() {}
   virtual void draw(QCPPainter *painter) const = 0;
   virtual void clear(const QColor &color) = 0;
+  virtual bool scroll(int dx, int dy, const QRect &rect);
   
 protected:
   // property members:
@@ -616,6 +632,7 @@ public:
   virtual QCPPainter *startPainting() Q_DECL_OVERRIDE;
   virtual void draw(QCPPainter *painter) const Q_DECL_OVERRIDE;
   void clear(const QColor &color) Q_DECL_OVERRIDE;
+  virtual bool scroll(int dx, int dy, const QRect &rect) Q_DECL_OVERRIDE;
   
 protected:
   // non-property members:
@@ -626,6 +643,27 @@ protected:
 };
 
 
+class QCP_LIB_DECL QCPPaintBufferImage : public QCPAbstractPaintBuffer
+{
+public:
+  explicit QCPPaintBufferImage(const QSize &size, double devicePixelRatio);
+  virtual ~QCPPaintBufferImage() Q_DECL_OVERRIDE;
+  
+  // reimplemented virtual methods:
+  virtual QCPPainter *startPainting() Q_DECL_OVERRIDE;
+  virtual void draw(QCPPainter *painter) const Q_DECL_OVERRIDE;
+  void clear(const QColor &color) Q_DECL_OVERRIDE;
+  virtual bool scroll(int dx, int dy, const QRect &rect) Q_DECL_OVERRIDE;
+  
+protected:
+  // non-property members:
+  QImage mBuffer;
+  
+  // reimplemented virtual methods:
+  virtual void reallocateBuffer() Q_DECL_OVERRIDE;
+};
+
+
 #ifdef QCP_OPENGL_PBUFFER
 class QCP_LIB_DECL QCPPaintBufferGlPbuffer : public QCPAbstractPaintBuffer
 {
@@ -714,10 +752,14 @@ public:
   QList<QCPLayerable*> children() const { return mChildren; }
   bool visible() const { return mVisible; }
   LayerMode mode() const { return mMode; }
+  QCPAxis *scrollAxis() const;
+  bool axisCache() const { return mAxisCache; }
   
   // setters:
   void setVisible(bool visible);
   void setMode(LayerMode mode);
+  void setScrollAxis(QCPAxis *axis);
+  void setAxisCache(bool enabled);
   
   // non-virtual methods:
   void replot();
@@ -730,13 +772,31 @@ protected:
   QList<QCPLayerable*> mChildren;
   bool mVisible;
   LayerMode mMode;
+  QPointer<QCPAxis> mScrollAxis;
+  bool mAxisCache;
   
   // non-property members:
   QWeakPointer<QCPAbstractPaintBuffer> mPaintBuffer;
+  bool mScrollStateValid, mScrollPending;
+  QRect mScrollAxisRect;
+  QVector<double> mScrollRanges; // lower and upper of the scroll axis, followed by those of the other axes in its axis rect
+  bool mScrollRangeReversed;
+  double mScrollDataEdge;
+  int mScrollMargin;
+  QPoint mScrollDelta;
+  QRect mScrollExposedRect;
+  bool mCacheStateValid, mCachePending;
+  QVector<double> mCacheState; // buffer size, geometry, ranges and tick coordinates of the axes on this layer
+  QVector<QString> mCacheLabels; // axis labels and tick labels of the axes on this layer
   
   // non-virtual methods:
-  void draw(QCPPainter *painter);
+  void draw(QCPPainter *painter, const QRect &exposedRect=QRect());
   void drawToPaintBuffer();
+  bool prepareScroll();
+  void updateScrollState();
+  bool prepareCache();
+  void updateCacheState();
+  bool getCacheState(QVector<double> &state, QVector<QString> &labels) const;
   void addChild(QCPLayerable *layerable, bool prepend);
   void removeChild(QCPLayerable *layerable);
   
@@ -745,6 +805,7 @@ private:
   
   friend class QCustomPlot;
   friend class QCPLayerable;
+  friend class QCPLayerRasterTask;
 };
 Q_DECLARE_METATYPE(QCPLayer::LayerMode)
 
@@ -2114,6 +2175,7 @@ protected:
   void drawSubGridLines(QCPPainter *painter) const;
   
   friend class QCPAxis;
+  friend class QCPLayer;
 };
 
 
@@ -2315,6 +2377,9 @@ public:
   void rescale(bool onlyVisiblePlottables=false);
   double pixelToCoord(double value) const;
   double coordToPixel(double value) const;
+  void pixelsToCoords(const double *pixels, double *coords, int count) const;
+  void coordsToPixels(const double *coords, double *pixels, int count) const;
+  void coordsToPixels(const double *coords, int coordStride, QPointF *pixels, int count) const;
   SelectablePart getPartAt(const QPointF &pos) const;
   QList<QCPAbstractPlottable*> plottables() const;
   QList<QCPGraph*> graphs() const;
@@ -2406,6 +2471,7 @@ protected:
   QFont getLabelFont() const;
   QColor getTickLabelColor() const;
   QColor getLabelColor() const;
+  void getPixelMapping(double &pixelOrigin, double &scale, double &invalidPixel) const;
   
 private:
   Q_DISABLE_COPY(QCPAxis)
@@ -2413,6 +2479,7 @@ private:
   friend class QCustomPlot;
   friend class QCPGrid;
   friend class QCPAxisRect;
+  friend class QCPLayer;
 };
 Q_DECLARE_OPERATORS_FOR_FLAGS(QCPAxis::SelectableParts)
 Q_DECLARE_OPERATORS_FOR_FLAGS(QCPAxis::AxisTypes)
@@ -2622,9 +2689,13 @@ public:
   int size() const { return mData.size()-mPreallocSize; }
   bool isEmpty() const { return size() == 0; }
   bool autoSqueeze() const { return mAutoSqueeze; }
+  int fixedCapacity() const { return mFixedCapacity; }
+  bool minMaxPyramid() const { return mMinMaxPyramid; }
   
   // setters:
   void setAutoSqueeze(bool enabled);
+  void setFixedCapacity(int capacity);
+  void setMinMaxPyramid(bool enabled);
   
   // non-virtual methods:
   void set(const QCPDataContainer<DataType> &data);
@@ -2632,6 +2703,8 @@ public:
   void add(const QCPDataContainer<DataType> &data);
   void add(const QVector<DataType> &data, bool alreadySorted=false);
   void add(const DataType &data);
+  iterator prepareAppend(int n);
+  void finishAppend(int n);
   void removeBefore(double sortKey);
   void removeAfter(double sortKey);
   void remove(double sortKeyFrom, double sortKeyTo);
@@ -2649,21 +2722,30 @@ public:
   const_iterator at(int index) const { return constBegin()+qBound(0, index, size()); }
   QCPRange keyRange(bool &foundRange, QCP::SignDomain signDomain=QCP::sdBoth);
   QCPRange valueRange(bool &foundRange, QCP::SignDomain signDomain=QCP::sdBoth, const QCPRange &inKeyRange=QCPRange());
+  QCPRange mainValueBounds(const_iterator begin, const_iterator end) const;
   QCPDataRange dataRange() const { return QCPDataRange(0, size()); }
   void limitIteratorsToDataRange(const_iterator &begin, const_iterator &end, const QCPDataRange &dataRange) const;
   
 protected:
   // property members:
   bool mAutoSqueeze;
+  int mFixedCapacity;
+  bool mMinMaxPyramid;
   
   // non-property memebers:
   QVector<DataType> mData;
   int mPreallocSize;
   int mPreallocIteration;
+  QVector<QVector<QCPRange> > mPyramid; // level 0 holds the main value bounds of blocks of 16 data points, each further level combines two blocks of the level below
+  int mPyramidSize; // number of entries of mData (including preallocation) that mPyramid has been updated for
   
   // non-virtual methods:
   void preallocateGrow(int minimumPreallocSize);
   void performAutoSqueeze();
+  void prepareFixedAppend(int n);
+  void applyFixedCapacity();
+  void invalidatePyramid();
+  void updatePyramid();
 };
 
 
@@ -2702,6 +2784,18 @@ protected:
   sort. Failing to do so can not be detected by the container efficiently and will cause both
   rendering artifacts and potential data loss.
 
+  For scrolling displays that run for a long time, the container can be limited to a fixed number
+  of data points with \ref setFixedCapacity. It then behaves like a ring buffer: when new data
+  points are added beyond the capacity, the ones with the smallest sort keys are dropped. The memory
+  is allocated once, and appending costs amortized O(1) per data point no matter how long the
+  session runs, while the data stays contiguous and sorted, so \ref findBegin and \ref findEnd
+  still use binary search.
+
+  For very large data sets, the container can maintain a min/max pyramid of the main values (see
+  \ref setMinMaxPyramid). It allows \ref mainValueBounds to find the smallest and largest value of
+  any index range in logarithmic time, which \ref QCPGraph uses for adaptive sampling of zoomed out
+  views.
+
   Implementing one-dimensional plottables that make use of a \ref QCPDataContainer<T> is usually
   done by subclassing from \ref QCPAbstractPlottable1D "QCPAbstractPlottable1D<T>", which
   introduces an according \a mDataContainer member and some convenience methods.
@@ -2805,8 +2899,11 @@ protected:
 template <class DataType>
 QCPDataContainer<DataType>::QCPDataContainer() :
   mAutoSqueeze(true),
+  mFixedCapacity(0),
+  mMinMaxPyramid(false),
   mPreallocSize(0),
-  mPreallocIteration(0)
+  mPreallocIteration(0),
+  mPyramidSize(0)
 {
 }
 
@@ -2829,6 +2926,63 @@ void QCPDataContainer<DataType>::setAutoSqueeze(bool enabled)
   }
 }
 
+/*!
+  Limits the container to at most \a capacity data points. Whenever data is added beyond this
+  limit, the data points with the smallest sort keys (for time series the oldest ones) are dropped.
+
+  In this mode the container allocates memory for twice the capacity once and keeps it, dropped
+  data points only move the begin of the container forward. Only when the end of the allocated
+  memory is reached, the remaining data points are moved back to the front, which happens at most
+  once per \a capacity added data points. Automatic squeezing (\ref setAutoSqueeze) is suspended
+  while a fixed capacity is set.
+
+  Set \a capacity to 0 (the default) to let the container grow without limit.
+*/
+template <class DataType>
+void QCPDataContainer<DataType>::setFixedCapacity(int capacity)
+{
+  capacity = qMax(0, capacity);
+  if (mFixedCapacity == capacity)
+    return;
+  
+  mFixedCapacity = capacity;
+  if (mFixedCapacity > 0)
+  {
+    applyFixedCapacity();
+    squeeze(true, false);
+    mData.reserve(2*mFixedCapacity);
+  } else if (mAutoSqueeze)
+    performAutoSqueeze();
+}
+
+/*!
+  Sets whether the container maintains a min/max pyramid of the main values of its data points.
+  This allows \ref mainValueBounds to work in logarithmic instead of linear time, e.g. to speed up
+  the adaptive sampling of \ref QCPGraph when a lot of data points are visible. The pyramid takes
+  about an eighth of the memory of the data points themselves.
+
+  The pyramid is updated by the modifying methods themselves, never by \ref mainValueBounds, so
+  several threads may query the same container at once (e.g. layers drawn with \ref
+  QCP::phParallelLayers). It is updated incrementally for data that is appended (e.g. with \ref add
+  or \ref prepareAppend) and removing data from the front (\ref removeBefore) costs nothing.
+  Operations that move data points within the container (inserts, prepends, \ref sort, \ref
+  squeeze, etc.) rebuild it.
+
+  \note If you change the main values of data points in-place through the non-const iterators
+  (\ref begin, \ref end), call \ref sort afterwards, which also rebuilds the pyramid.
+*/
+template <class DataType>
+void QCPDataContainer<DataType>::setMinMaxPyramid(bool enabled)
+{
+  if (mMinMaxPyramid != enabled)
+  {
+    mMinMaxPyramid = enabled;
+    invalidatePyramid();
+    mPyramid.squeeze();
+    updatePyramid();
+  }
+}
+
 /*! \overload
   
   Replaces the current data in this container with the provided \a data.
@@ -2857,8 +3011,16 @@ void QCPDataContainer<DataType>::set(const QVector<DataType> &data, bool already
   mData = data;
   mPreallocSize = 0;
   mPreallocIteration = 0;
+  invalidatePyramid();
   if (!alreadySorted)
     sort();
+  if (mFixedCapacity > 0)
+  {
+    applyFixedCapacity();
+    squeeze(true, false);
+    mData.reserve(2*mFixedCapacity);
+  }
+  updatePyramid();
 }
 
 /*! \overload
@@ -2882,13 +3044,20 @@ void QCPDataContainer<DataType>::add(const QCPDataContainer<DataType> &data)
       preallocateGrow(n);
     mPreallocSize -= n;
     std::copy(data.constBegin(), data.constEnd(), begin());
+    invalidatePyramid();
   } else // don't need to prepend, so append and merge if necessary
   {
+    prepareFixedAppend(n);
     mData.resize(mData.size()+n);
     std::copy(data.constBegin(), data.constEnd(), end()-n);
     if (oldSize > 0 && !qcpLessThanSortKey<DataType>(*(constEnd()-n-1), *(constEnd()-n))) // if appended range keys aren't all greater than existing ones, merge the two partitions
+    {
       std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>);
+      invalidatePyramid();
+    }
   }
+  applyFixedCapacity();
+  updatePyramid();
 }
 
 /*!
@@ -2919,15 +3088,22 @@ void QCPDataContainer<DataType>::add(const QVector<DataType> &data, bool already
       preallocateGrow(n);
     mPreallocSize -= n;
     std::copy(data.constBegin(), data.constEnd(), begin());
+    invalidatePyramid();
   } else // don't need to prepend, so append and then sort and merge if necessary
   {
+    prepareFixedAppend(n);
     mData.resize(mData.size()+n);
     std::copy(data.constBegin(), data.constEnd(), end()-n);
     if (!alreadySorted) // sort appended subrange if it wasn't already sorted
       std::sort(end()-n, end(), qcpLessThanSortKey<DataType>);
     if (oldSize > 0 && !qcpLessThanSortKey<DataType>(*(constEnd()-n-1), *(constEnd()-n))) // if appended range keys aren't all greater than existing ones, merge the two partitions
+    {
       std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>);
+      invalidatePyramid();
+    }
   }
+  applyFixedCapacity();
+  updatePyramid();
 }
 
 /*! \overload
@@ -2941,6 +3117,7 @@ void QCPDataContainer<DataType>::add(const DataType &data)
 {
   if (isEmpty() || !qcpLessThanSortKey<DataType>(data, *(constEnd()-1))) // quickly handle appends if new data key is greater or equal to existing ones
   {
+    prepareFixedAppend(1);
     mData.append(data);
   } else if (qcpLessThanSortKey<DataType>(data, *constBegin()))  // quickly handle prepends using preallocated space
   {
@@ -2948,11 +3125,55 @@ void QCPDataContainer<DataType>::add(const DataType &data)
       preallocateGrow(1);
     --mPreallocSize;
     *begin() = data;
+    invalidatePyramid();
   } else // handle inserts, maintaining sorted keys
   {
     QCPDataContainer<DataType>::iterator insertionPoint = std::lower_bound(begin(), end(), data, qcpLessThanSortKey<DataType>);
     mData.insert(insertionPoint, data);
+    invalidatePyramid();
   }
+  applyFixedCapacity();
+  updatePyramid();
+}
+
+/*!
+  Appends \a n data points at the end of the container and returns an iterator to the first of
+  them, so they can be written in-place (e.g. directly from an acquisition buffer) without
+  building an intermediate QVector. The new data points are default constructed and use the
+  postallocated space of the container, so consecutive appends don't reallocate.
+
+  The new data points must be written in ascending sort key order, and \ref finishAppend must be
+  called with the same \a n before any other method is called on the container.
+
+  \see finishAppend, add
+*/
+template <class DataType>
+typename QCPDataContainer<DataType>::iterator QCPDataContainer<DataType>::prepareAppend(int n)
+{
+  prepareFixedAppend(n);
+  mData.resize(mData.size()+n);
+  return end()-n;
+}
+
+/*!
+  Completes an append started with \ref prepareAppend. If the sort keys of the \a n appended data
+  points aren't all greater than or equal to the existing ones, the two partitions are merged so
+  the container is sorted again. In the common case of monotonic data (e.g. time series), this is a
+  single comparison.
+
+  \see prepareAppend
+*/
+template <class DataType>
+void QCPDataContainer<DataType>::finishAppend(int n)
+{
+  const int oldSize = size()-n;
+  if (n > 0 && oldSize > 0 && !qcpLessThanSortKey<DataType>(*(constEnd()-n-1), *(constEnd()-n))) // if appended range keys aren't all greater than existing ones, merge the two partitions
+  {
+    std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>);
+    invalidatePyramid();
+  }
+  applyFixedCapacity();
+  updatePyramid();
 }
 
 /*!
@@ -2981,8 +3202,10 @@ void QCPDataContainer<DataType>::removeAfter(double sortKey)
   QCPDataContainer<DataType>::iterator it = std::upper_bound(begin(), end(), DataType::fromSortKey(sortKey), qcpLessThanSortKey<DataType>);
   QCPDataContainer<DataType>::iterator itEnd = end();
   mData.erase(it, itEnd); // typically adds it to the postallocated block
+  invalidatePyramid();
   if (mAutoSqueeze)
     performAutoSqueeze();
+  updatePyramid();
 }
 
 /*!
@@ -3001,8 +3224,10 @@ void QCPDataContainer<DataType>::remove(double sortKeyFrom, double sortKeyTo)
   QCPDataContainer<DataType>::iterator it = std::lower_bound(begin(), end(), DataType::fromSortKey(sortKeyFrom), qcpLessThanSortKey<DataType>);
   QCPDataContainer<DataType>::iterator itEnd = std::upper_bound(it, end(), DataType::fromSortKey(sortKeyTo), qcpLessThanSortKey<DataType>);
   mData.erase(it, itEnd);
+  invalidatePyramid();
   if (mAutoSqueeze)
     performAutoSqueeze();
+  updatePyramid();
 }
 
 /*! \overload
@@ -3023,10 +3248,14 @@ void QCPDataContainer<DataType>::remove(double sortKey)
     if (it == begin())
       ++mPreallocSize; // don't actually delete, just add it to the preallocated block (if it gets too large, squeeze will take care of it)
     else
+    {
       mData.erase(it);
+      invalidatePyramid();
+    }
   }
   if (mAutoSqueeze)
     performAutoSqueeze();
+  updatePyramid();
 }
 
 /*!
@@ -3040,6 +3269,9 @@ void QCPDataContainer<DataType>::clear()
   mData.clear();
   mPreallocIteration = 0;
   mPreallocSize = 0;
+  invalidatePyramid();
+  if (mFixedCapacity > 0)
+    mData.reserve(2*mFixedCapacity);
 }
 
 /*!
@@ -3057,6 +3289,8 @@ template <class DataType>
 void QCPDataContainer<DataType>::sort()
 {
   std::sort(begin(), end(), qcpLessThanSortKey<DataType>);
+  invalidatePyramid();
+  updatePyramid();
 }
 
 /*!
@@ -3079,11 +3313,13 @@ void QCPDataContainer<DataType>::squeeze(bool preAllocation, bool postAllocation
       std::copy(begin(), end(), mData.begin());
       mData.resize(size());
       mPreallocSize = 0;
+      invalidatePyramid();
     }
     mPreallocIteration = 0;
   }
   if (postAllocation)
     mData.squeeze();
+  updatePyramid();
 }
 
 /*!
@@ -3377,6 +3613,74 @@ void QCPDataContainer<DataType>::limitIteratorsToDataRange(const_iterator &begin
   end = constBegin()+iteratorRange.end();
 }
 
+/*!
+  Returns the smallest and largest main value of the data points between \a begin and \a end. NaN
+  values are ignored. If there is no non-NaN value in the range, the returned range has a lower
+  bound of positive infinity and an upper bound of negative infinity.
+
+  If the min/max pyramid is enabled (see \ref setMinMaxPyramid), this takes logarithmic time in
+  the size of the range, otherwise linear time. It only reads the pyramid, so it is safe to call
+  from several threads as long as the container isn't modified at the same time.
+*/
+template <class DataType>
+QCPRange QCPDataContainer<DataType>::mainValueBounds(const_iterator begin, const_iterator end) const
+{
+  QCPRange bounds;
+  bounds.lower = std::numeric_limits<double>::infinity();
+  bounds.upper = -std::numeric_limits<double>::infinity();
+  
+  int first = int(begin-mData.constBegin());
+  int last = int(end-mData.constBegin());
+  // the pyramid is out of date only between prepareAppend and finishAppend, or after the data was
+  // modified through the non-const iterators without calling sort:
+  if (mMinMaxPyramid && mPyramidSize == mData.size() && last-first > 32)
+  {
+    // scan the data points before the first and after the last complete block:
+    for (; first < last && first % 16 != 0; ++first)
+    {
+      const double value = mData.at(first).mainValue();
+      if (value < bounds.lower) bounds.lower = value;
+      if (value > bounds.upper) bounds.upper = value;
+    }
+    for (; last > first && last % 16 != 0; --last)
+    {
+      const double value = mData.at(last-1).mainValue();
+      if (value < bounds.lower) bounds.lower = value;
+      if (value > bounds.upper) bounds.upper = value;
+    }
+    // walk up the pyramid, combining blocks that are not covered by a block of the next level:
+    int firstBlock = first/16;
+    int lastBlock = last/16;
+    for (int level = 0; firstBlock < lastBlock; ++level)
+    {
+      const QVector<QCPRange> &blocks = mPyramid.at(level);
+      if (firstBlock % 2 != 0)
+      {
+        bounds.lower = qMin(bounds.lower, blocks.at(firstBlock).lower);
+        bounds.upper = qMax(bounds.upper, blocks.at(firstBlock).upper);
+        ++firstBlock;
+      }
+      if (lastBlock % 2 != 0)
+      {
+        --lastBlock;
+        bounds.lower = qMin(bounds.lower, blocks.at(lastBlock).lower);
+        bounds.upper = qMax(bounds.upper, blocks.at(lastBlock).upper);
+      }
+      firstBlock /= 2;
+      lastBlock /= 2;
+    }
+  } else
+  {
+    for (; first < last; ++first)
+    {
+      const double value = mData.at(first).mainValue();
+      if (value < bounds.lower) bounds.lower = value;
+      if (value > bounds.upper) bounds.upper = value;
+    }
+  }
+  return bounds;
+}
+
 /*! \internal
   
   Increases the preallocation pool to have a size of at least \a minimumPreallocSize. Depending on
@@ -3400,6 +3704,7 @@ void QCPDataContainer<DataType>::preallocateGrow(int minimumPreallocSize)
   mData.resize(mData.size()+sizeDifference);
   std::copy_backward(mData.begin()+mPreallocSize, mData.end()-sizeDifference, mData.end());
   mPreallocSize = newPreallocSize;
+  invalidatePyramid();
 }
 
 /*! \internal
@@ -3419,6 +3724,9 @@ void QCPDataContainer<DataType>::preallocateGrow(int minimumPreallocSize)
 template <class DataType>
 void QCPDataContainer<DataType>::performAutoSqueeze()
 {
+  if (mFixedCapacity > 0) // memory is allocated once and kept in fixed capacity mode
+    return;
+  
   const int totalAlloc = mData.capacity();
   const int postAllocSize = totalAlloc-mData.size();
   const int usedSize = size();
@@ -3438,6 +3746,112 @@ void QCPDataContainer<DataType>::performAutoSqueeze()
     squeeze(shrinkPreAllocation, shrinkPostAllocation);
 }
 
+/*! \internal
+  
+  In fixed capacity mode (see \ref setFixedCapacity), makes sure \a n data points can be appended
+  without reallocation. If the allocated memory is used up, the current data points are moved to
+  the front of the allocation, reusing the space of the dropped data points.
+  
+  Does nothing if no fixed capacity is set.
+*/
+template <class DataType>
+void QCPDataContainer<DataType>::prepareFixedAppend(int n)
+{
+  if (mFixedCapacity > 0 && mPreallocSize > 0 && mData.size()+n > mData.capacity())
+  {
+    std::copy(begin(), end(), mData.begin());
+    mData.resize(size());
+    mPreallocSize = 0;
+    invalidatePyramid();
+  }
+}
+
+/*! \internal
+  
+  Marks the min/max pyramid as outdated after data points were moved within \a mData. The
+  modifying method rebuilds it with \ref updatePyramid before returning.
+*/
+template <class DataType>
+void QCPDataContainer<DataType>::invalidatePyramid()
+{
+  mPyramidSize = 0;
+  for (int level=0; level<mPyramid.size(); ++level)
+    mPyramid[level].resize(0);
+}
+
+/*! \internal
+  
+  Brings the min/max pyramid up to date with the data points appended to \a mData since the last
+  update. Called at the end of every public method that modifies \a mData, so \ref
+  mainValueBounds never needs to write to the pyramid. Does nothing if the pyramid is disabled.
+  Only complete blocks of 16 data points are stored, so the blocks of each level never
+  need to be changed again once they were added (until the pyramid is invalidated).
+  
+  The blocks are aligned to the indices of \a mData, including the preallocation at the front.
+  Blocks that cover preallocated entries hold outdated values, but \ref mainValueBounds only uses
+  blocks that are entirely inside the queried range, so they are never read.
+*/
+template <class DataType>
+void QCPDataContainer<DataType>::updatePyramid()
+{
+  if (!mMinMaxPyramid || mPyramidSize == mData.size())
+    return;
+  if (mPyramidSize > mData.size())
+    invalidatePyramid();
+  
+  if (mPyramid.isEmpty())
+    mPyramid.append(QVector<QCPRange>());
+  
+  // level 0, bounds of 16 data points each, ignoring NaN:
+  const int blockCount = mData.size()/16;
+  mPyramid[0].reserve(blockCount);
+  for (int block=mPyramid.at(0).size(); block<blockCount; ++block)
+  {
+    QCPRange bounds;
+    bounds.lower = std::numeric_limits<double>::infinity();
+    bounds.upper = -std::numeric_limits<double>::infinity();
+    for (int i=block*16; i<block*16+16; ++i)
+    {
+      const double value = mData.at(i).mainValue();
+      if (value < bounds.lower) bounds.lower = value;
+      if (value > bounds.upper) bounds.upper = value;
+    }
+    mPyramid[0].append(bounds);
+  }
+  
+  // higher levels, combining two blocks of the level below each:
+  for (int level=1; mPyramid.at(level-1).size() >= 2; ++level)
+  {
+    if (mPyramid.size() <= level)
+      mPyramid.append(QVector<QCPRange>());
+    const QVector<QCPRange> &below = mPyramid.at(level-1);
+    QVector<QCPRange> &blocks = mPyramid[level];
+    for (int block=blocks.size(); block<below.size()/2; ++block)
+    {
+      QCPRange bounds;
+      bounds.lower = qMin(below.at(2*block).lower, below.at(2*block+1).lower);
+      bounds.upper = qMax(below.at(2*block).upper, below.at(2*block+1).upper);
+      blocks.append(bounds);
+    }
+  }
+  mPyramidSize = mData.size();
+}
+
+/*! \internal
+  
+  In fixed capacity mode (see \ref setFixedCapacity), drops the data points with the smallest sort
+  keys until at most the capacity is left. Like \ref removeBefore, the dropped data points are just
+  added to the preallocated block.
+  
+  Does nothing if no fixed capacity is set.
+*/
+template <class DataType>
+void QCPDataContainer<DataType>::applyFixedCapacity()
+{
+  if (mFixedCapacity > 0 && size() > mFixedCapacity)
+    mPreallocSize += size()-mFixedCapacity;
+}
+
 
 /* end of 'src/datacontainer.h' */
 
@@ -3846,6 +4260,7 @@ public:
   QCP::SelectionRectMode selectionRectMode() const { return mSelectionRectMode; }
   QCPSelectionRect *selectionRect() const { return mSelectionRect; }
   bool openGl() const { return mOpenGl; }
+  QThreadPool *threadPool() const { return mThreadPool; }
   
   // setters:
   void setViewport(const QRect &rect);
@@ -3937,6 +4352,7 @@ public:
   bool saveBmp(const QString &fileName, int width=0, int height=0, double scale=1.0, int resolution=96, QCP::ResolutionUnit resolutionUnit=QCP::ruDotsPerInch);
   bool saveRastered(const QString &fileName, int width, int height, double scale, const char *format, int quality=-1, int resolution=96, QCP::ResolutionUnit resolutionUnit=QCP::ruDotsPerInch);
   QPixmap toPixmap(int width=0, int height=0, double scale=1.0);
+  QImage toImage(int width=0, int height=0, double scale=1.0);
   void toPainter(QCPPainter *painter, int width=0, int height=0);
   Q_SLOT void replot(QCustomPlot::RefreshPriority refreshPriority=QCustomPlot::rpRefreshHint);
   double replotTime(bool average=false) const;
@@ -4002,6 +4418,7 @@ protected:
   bool mReplotting;
   bool mReplotQueued;
   double mReplotTime, mReplotTimeAverage;
+  QThreadPool *mThreadPool;
   int mOpenGlMultisamples;
   QCP::AntialiasedElements mOpenGlAntialiasedElementsBackup;
   bool mOpenGlCacheLabelsBackup;
@@ -4040,6 +4457,7 @@ protected:
   QList<QCPLayerable*> layerableListAt(const QPointF &pos, bool onlySelectable, QList<QVariant> *selectionDetails=nullptr) const;
   void drawBackground(QCPPainter *painter);
   void setupPaintBuffers();
+  void drawLayersToPaintBuffers();
   QCPAbstractPaintBuffer *createPaintBuffer();
   bool hasInvalidatedPaintBuffers();
   bool setupOpenGl();
@@ -4621,18 +5039,31 @@ double QCPAbstractPlottable1D<DataType>::selectTest(const QPointF &pos, bool onl
     return -1;
   QCPRange keyRange(mKeyAxis->range());
   QCPRange valueRange(mValueAxis->range());
+  // collect the data points inside the visible range (for speedup in cases where sort key isn't main key and we iterate over all points):
+  QVector<double> keys, values;
+  QVector<int> indices;
   for (typename QCPDataContainer<DataType>::const_iterator it=begin; it!=end; ++it)
   {
     const double mainKey = it->mainKey();
     const double mainValue = it->mainValue();
-    if (keyRange.contains(mainKey) && valueRange.contains(mainValue)) // make sure data point is inside visible range, for speedup in cases where sort key isn't main key and we iterate over all points
+    if (keyRange.contains(mainKey) && valueRange.contains(mainValue))
     {
-      const double currentDistSqr = QCPVector2D(coordsToPixels(mainKey, mainValue)-pos).lengthSquared();
-      if (currentDistSqr < minDistSqr)
-      {
-        minDistSqr = currentDistSqr;
-        minDistIndex = int(it-mDataContainer->constBegin());
-      }
+      keys.append(mainKey);
+      values.append(mainValue);
+      indices.append(int(it-mDataContainer->constBegin()));
+    }
+  }
+  // transform them to pixels in one batch per axis and find the closest one:
+  QVector<QPointF> points(keys.size());
+  mKeyAxis->coordsToPixels(keys.constData(), 1, points.data(), points.size());
+  mValueAxis->coordsToPixels(values.constData(), 1, points.data(), points.size());
+  for (int i=0; i<points.size(); ++i)
+  {
+    const double currentDistSqr = QCPVector2D(points.at(i)-pos).lengthSquared();
+    if (currentDistSqr < minDistSqr)
+    {
+      minDistSqr = currentDistSqr;
+      minDistIndex = indices.at(i);
     }
   }
   if (minDistIndex != mDataContainer->size())
@@ -4841,6 +5272,7 @@ protected:
   // non-virtual methods:
   bool stopsUseAlpha() const;
   void updateColorBuffer();
+  void colorizeLine(const double *data, const unsigned char *alpha, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor, bool logarithmic);
 };
 Q_DECLARE_METATYPE(QCPColorGradient::ColorInterpolation)
 Q_DECLARE_METATYPE(QCPColorGradient::NanHandling)
@@ -5569,6 +6001,8 @@ protected:
   
   // non-virtual methods:
   void getVisibleDataBounds(QCPGraphDataContainer::const_iterator &begin, QCPGraphDataContainer::const_iterator &end, const QCPDataRange &rangeRestriction) const;
+  QCPDataRange getClipDataRange(const QCPPainter *painter) const;
+  void getClusteredLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const;
   void getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange) const;
   void getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataRange) const;
   QVector<QPointF> dataToLines(const QVector<QCPGraphData> &data) const;
@@ -5695,6 +6129,7 @@ protected:
   // non-virtual methods:
   void getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRange, double penWidth) const;
   void getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataRange, double scatterWidth) const;
+  void appendCurvePixels(QVector<QPointF> *lines, QCPCurveDataContainer::const_iterator begin, QCPCurveDataContainer::const_iterator end) const;
   int getRegion(double key, double value, double keyMin, double valueMax, double keyMax, double valueMin) const;
   QPointF getOptimizedPoint(int otherRegion, double otherKey, double otherValue, double key, double value, double keyMin, double valueMax, double keyMax, double valueMin) const;
   QVector<QPointF> getOptimizedCornerPoints(int prevRegion, int currentRegion, double prevKey, double prevValue, double key, double value, double keyMin, double valueMax, double keyMax, double valueMin) const;
@@ -5886,6 +6321,7 @@ protected:
   // non-virtual methods:
   void getVisibleDataBounds(QCPBarsDataContainer::const_iterator &begin, QCPBarsDataContainer::const_iterator &end) const;
   QRectF getBarRect(double key, double value) const;
+  QVector<QRectF> getBarRects(QCPBarsDataContainer::const_iterator begin, QCPBarsDataContainer::const_iterator end) const;
   void getPixelWidth(double key, double &lower, double &upper) const;
   double getStackedBaseValue(double key, bool positive) const;
   static void connectBars(QCPBars* lower, QCPBars* upper);
@@ -6005,6 +6441,7 @@ protected:
   
   // non-virtual methods:
   void getVisibleDataBounds(QCPStatisticalBoxDataContainer::const_iterator &begin, QCPStatisticalBoxDataContainer::const_iterator &end) const;
+  void getBoxPixels(QCPStatisticalBoxDataContainer::const_iterator begin, QCPStatisticalBoxDataContainer::const_iterator end, double *keyPixels, double *valuePixels) const;
   QRectF getQuartileBox(QCPStatisticalBoxDataContainer::const_iterator it) const;
   QVector<QLineF> getWhiskerBackboneLines(QCPStatisticalBoxDataContainer::const_iterator it) const;
   QVector<QLineF> getWhiskerBarLines(QCPStatisticalBoxDataContainer::const_iterator it) const;
@@ -6054,6 +6491,7 @@ public:
   void clearAlpha();
   void fill(double z);
   void fillAlpha(unsigned char alpha);
+  void scrollKey(int cellCount);
   bool isEmpty() const { return mIsEmpty; }
   void coordToCell(double key, double value, int *keyIndex, int *valueIndex) const;
   void cellToCoord(int keyIndex, int valueIndex, double *key, double *value) const;
@@ -6069,6 +6507,8 @@ protected:
   unsigned char *mAlpha;
   QCPRange mDataBounds;
   bool mDataModified;
+  QRect mModifiedCells; // cells changed individually since the last map image update, x is the key and y the value index
+  int mKeyShift; // number of cells the data was scrolled by (see scrollKey) since the last map image update
   
   bool createAlpha(bool initializeOpaque=true);
   
@@ -6145,8 +6585,13 @@ protected:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
   
+  // non-virtual methods:
+  void colorizeCells(QImage *image, const QRect &cells);
+  void shiftMapImage(QImage *image, int keyShift) const;
+  
   friend class QCustomPlot;
   friend class QCPLegend;
+  friend class QCPColorMapColorizeTask;
 };
 
 /* end of 'src/plottables/plottable-colormap.h' */
@@ -6278,10 +6723,12 @@ protected:
   void drawOhlcPlot(QCPPainter *painter, const QCPFinancialDataContainer::const_iterator &begin, const QCPFinancialDataContainer::const_iterator &end, bool isSelected);
   void drawCandlestickPlot(QCPPainter *painter, const QCPFinancialDataContainer::const_iterator &begin, const QCPFinancialDataContainer::const_iterator &end, bool isSelected);
   double getPixelWidth(double key, double keyPixel) const;
+  void getOhlcPixels(const QCPFinancialDataContainer::const_iterator &begin, const QCPFinancialDataContainer::const_iterator &end, QVector<double> &keyPixels, QVector<double> &widthPixels, QVector<double> &valuePixels) const;
   double ohlcSelectTest(const QPointF &pos, const QCPFinancialDataContainer::const_iterator &begin, const QCPFinancialDataContainer::const_iterator &end, QCPFinancialDataContainer::const_iterator &closestDataPoint) const;
   double candlestickSelectTest(const QPointF &pos, const QCPFinancialDataContainer::const_iterator &begin, const QCPFinancialDataContainer::const_iterator &end, QCPFinancialDataContainer::const_iterator &closestDataPoint) const;
   void getVisibleDataBounds(QCPFinancialDataContainer::const_iterator &begin, QCPFinancialDataContainer::const_iterator &end) const;
   QRectF selectionHitBox(QCPFinancialDataContainer::const_iterator it) const;
+  QVector<QRectF> selectionHitBoxes(const QCPFinancialDataContainer::const_iterator &begin, const QCPFinancialDataContainer::const_iterator &end) const;
   
   friend class QCustomPlot;
   friend class QCPLegend;
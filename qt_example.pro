@@ -20,7 +20,17 @@ SOURCES += main.cpp\
 
 
 HEADERS  += mainwindow.h \
-        qcustomplot.h
+        qcustomplot.h \
+        sampleringbuffer.h \
+        capnoview.h \
+        timeaxisticker.h \
+        reportrenderer.h \
+        capnosimulator.h \
+        sampleclock.h \
+        sessionrecorder.h \
+        sessionreplay.h \
+        breathdetector.h \
+        hrvanalyzer.h
 
 FORMS    += mainwindow.ui
 
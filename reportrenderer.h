@@ -0,0 +1,139 @@
+#ifndef REPORTRENDERER_H
+#define REPORTRENDERER_H
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <QString>
+#include <QImage>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QTimer>
+
+#include "qcustomplot.h"
+#include "timeaxisticker.h"
+
+
+// one session report: the CO2 curve of a recorded session, saved as an image.
+struct CapnoReport
+{
+    QString fileName;       // format is deduced from the suffix (png, jpg, bmp).
+    QVector<double> time;   // in sec., sorted ascending.
+    QVector<double> co2;    // in mmHg, same length as time.
+};
+
+
+// Renders many session reports with a single, never shown QCustomPlot.
+//
+// Axes, ticker and pens are set up once in the constructor, every report only
+// swaps the graph data and renders into a QImage (no platform pixmaps, so the
+// offscreen platform plugin is enough: QT_QPA_PLATFORM=offscreen). Compressing
+// and writing the files, the bulk of the cost, runs on a thread pool while the
+// next report is plotted.
+//
+// QCustomPlot is a QWidget, so the plotting itself stays in the thread that
+// created the renderer (the GUI thread). render() may be called from any
+// thread though: from another thread, each report is plotted by a queued call
+// in the renderer's thread, whose event loop must be running, so a batch
+// export on a worker thread only blocks the GUI for one plot at a time.
+class ReportRenderer
+{
+public:
+    ReportRenderer(int width, int height, double scale = 1.0)
+        : width(width), height(height), scale(scale)
+    {
+        plot.resize(width, height);
+        plot.addGraph();
+        plot.graph(0)->setPen(QPen(Qt::darkGreen));
+        plot.xAxis->setLabel("Time (in sec.)");
+        plot.yAxis->setLabel("Raw PCO2 (in mmHg)");
+        plot.yAxis->setRange(0, 50);
+        QSharedPointer<TimeAxisTicker> timeTicker(new TimeAxisTicker);
+        plot.xAxis->setTicker(timeTicker);
+    }
+
+    ~ReportRenderer()
+    {
+        encoders.waitForDone();
+    }
+
+    // renders all reports and returns the number of files written
+    // successfully. Blocks until all files are written. Not reentrant, one
+    // batch at a time.
+    int render(const std::vector<CapnoReport> &reports)
+    {
+        savedCount.store(0);
+        for (const CapnoReport &report : reports)
+            encoders.start(new SaveTask(plotReport(report), report.fileName, savedCount));
+        encoders.waitForDone();
+        return savedCount.load();
+    }
+
+    // the image of one report, without saving it.
+    QImage plotReport(const CapnoReport &report)
+    {
+        if (QThread::currentThread() == plot.thread())
+            return plotNow(report);
+
+        QImage image;
+        QSemaphore done;
+        QTimer::singleShot(0, &plot, [&]() {
+            image = plotNow(report);
+            done.release();
+        });
+        done.acquire();
+        return image;
+    }
+
+private:
+    // writes one rendered image, runs on the encoder pool.
+    class SaveTask : public QRunnable
+    {
+    public:
+        SaveTask(const QImage &image, const QString &fileName, std::atomic<int> &savedCount)
+            : image(image), fileName(fileName), savedCount(savedCount) {}
+
+        void run() override
+        {
+            if (!image.isNull() && image.save(fileName))
+                savedCount.fetch_add(1);
+        }
+
+    private:
+        QImage image;
+        QString fileName;
+        std::atomic<int> &savedCount;
+    };
+
+    // swaps the graph data and renders, in the thread of the plot only.
+    QImage plotNow(const CapnoReport &report)
+    {
+        const int count = std::min(report.time.size(), report.co2.size());
+        graphData.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            graphData[i].key = report.time[i];
+            graphData[i].value = report.co2[i];
+        }
+        plot.graph(0)->data()->set(graphData, true);
+        if (count > 0)
+            plot.xAxis->setRange(graphData.first().key, graphData.last().key);
+        return plot.toImage(width, height, scale);
+    }
+
+    int width;
+    int height;
+    double scale;
+
+    QCustomPlot plot;
+    QVector<QCPGraphData> graphData;   // reused for every report.
+    QThreadPool encoders;
+    std::atomic<int> savedCount{0};
+};
+
+
+#endif // REPORTRENDERER_H
@@ -0,0 +1,130 @@
+#ifndef SAMPLECLOCK_H
+#define SAMPLECLOCK_H
+
+#include <cmath>
+#include <cstddef>
+
+
+// Recovers the sample clock of one device from the packet arrival times.
+//
+// The device samples at a fixed rate (nominally, every device drifts a bit)
+// but the packets arrive with USB and scheduling jitter. A second order
+// delay-locked loop tracks the time of the last sample and the sample period
+// from the arrival times, so the timestamps follow the device clock over
+// long sessions without taking over the jitter of single packets.
+//
+// Not thread-safe, feed each clock from one thread at a time.
+class SampleClock
+{
+public:
+    // nominalRate in samples per sec., 0 measures it from the first packets.
+    // bandwidth (in Hz) trades jitter suppression against how fast drift and
+    // rate steps are followed.
+    explicit SampleClock(double nominalRate = 0.0, double bandwidth = 0.05)
+        : nominalPeriod(nominalRate > 0 ? 1.0 / nominalRate : 0.0), bandwidth(bandwidth)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        period = referencePeriod = nominalPeriod;
+        lastTime = 0;
+        firstArrival = 0;
+        measuredCount = 0;
+        state = Idle;
+    }
+
+    // samples per sec. as currently tracked, 0 before it is known.
+    double rate() const { return period > 0 ? 1.0 / period : 0.0; }
+
+    // takes the arrival time (in sec., monotonic) of a packet with count
+    // samples. Returns the time of its first sample and writes the spacing
+    // of the samples to samplePeriod. The times are strictly increasing over
+    // consecutive packets.
+    double update(double arrival, size_t count, double &samplePeriod)
+    {
+        if (count == 0)
+        {
+            samplePeriod = 0;
+            return lastTime;
+        }
+
+        if (state == Idle)
+        {
+            firstArrival = arrival;
+            if (period > 0)
+            {
+                state = Locked;
+                lastTime = arrival - count * period;
+                return spread(arrival, count, samplePeriod);
+            }
+            // no rate yet, the samples of the first packet get 1 ms spacing.
+            state = Measuring;
+            lastTime = arrival - count * 1e-3;
+            return spread(arrival, count, samplePeriod);
+        }
+
+        if (state == Measuring)
+        {
+            // the samples after the first packet were taken since its
+            // arrival, average over a second to get past the jitter.
+            measuredCount += count;
+            if (arrival - firstArrival >= 1.0)
+            {
+                period = referencePeriod = (arrival - firstArrival) / measuredCount;
+                state = Locked;
+            }
+            return spread(arrival, count, samplePeriod);
+        }
+
+        // predicted time of the last sample of this packet and the loop
+        // coefficients for the time span it covers.
+        const double pi = 3.14159265358979323846;
+        double predicted = lastTime + count * period;
+        double omega = 2.0 * pi * bandwidth * count * period;
+        double error = arrival - predicted;
+
+        // a gap of seconds (device switched off, port reopened) is no drift, start over.
+        if (std::fabs(error) > 2.0)
+        {
+            lastTime = std::fmax(lastTime, arrival - count * period);
+            return spread(arrival, count, samplePeriod);
+        }
+
+        period += omega * omega * error / count;
+        // no real device is more than 10% off.
+        if (period < 0.9 * referencePeriod || period > 1.1 * referencePeriod)
+            period = referencePeriod;
+        return spread(predicted + std::sqrt(2.0) * omega * error, count, samplePeriod);
+    }
+
+private:
+    enum State { Idle, Measuring, Locked };
+
+    // places count samples evenly after lastTime, the last one at end.
+    double spread(double end, size_t count, double &samplePeriod)
+    {
+        // never go back in time. After a late packet the samples of the next
+        // one are just squeezed a bit.
+        double minSpacing = period > 0 ? 0.5 * period : 1e-6;
+        end = std::fmax(end, lastTime + count * minSpacing);
+        samplePeriod = (end - lastTime) / count;
+        double first = lastTime + samplePeriod;
+        lastTime = end;
+        return first;
+    }
+
+    double nominalPeriod;
+    double bandwidth;
+
+    double period;           // sec. per sample.
+    double referencePeriod;  // nominal or measured period, bounds the drift.
+    double lastTime;         // time of the last sample handed out.
+    double firstArrival;     // arrival of the first packet.
+    size_t measuredCount;    // samples since then (rate measuring).
+    State state;
+};
+
+
+#endif // SAMPLECLOCK_H
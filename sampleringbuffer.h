@@ -0,0 +1,146 @@
+#ifndef SAMPLERINGBUFFER_H
+#define SAMPLERINGBUFFER_H
+
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+// one sample on the graph: the time point (in sec.) and the value.
+struct TimedSample
+{
+    double time;
+    float value;
+};
+
+
+// Bounded multi-producer/single-consumer ring buffer.
+//
+// The producers are the threads that call the user callback: the library
+// does not promise a single io thread (CapnoTrainer runs an io_thread and a
+// tg thread group), and the simulator or replay threads may feed it too.
+// The consumer is the GUI thread (graph timer). Neither side ever takes a
+// lock or allocates after construction. A producer reserves a slot with a
+// CAS on the write index and publishes it through the slot's sequence
+// number, so the consumer only takes slots that are completely written.
+// When the buffer is full the new samples are dropped and counted in
+// overflowCount(), so a slow replot can never stall serial reads.
+template <typename T>
+class SampleRingBuffer
+{
+public:
+    // capacity is rounded up to the next power of two.
+    explicit SampleRingBuffer(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        buffer.resize(size);
+        mask = size - 1;
+        // slot i is free for the write index i.
+        sequences.reset(new std::atomic<size_t>[size]);
+        for (size_t i = 0; i < size; i++)
+            sequences[i].store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return buffer.size(); }
+
+    // number of samples that are reserved or waiting to be consumed
+    // (approximate when called while producers are writing).
+    size_t size() const
+    {
+        return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+    }
+
+    // number of samples dropped because the consumer did not keep up.
+    uint64_t overflowCount() const { return overflows.load(std::memory_order_relaxed); }
+
+
+    // producer side, any thread: returns false (and counts an overflow) if
+    // the ring is full.
+    bool push(const T &item)
+    {
+        size_t write = writeIndex.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            const size_t sequence = sequences[write & mask].load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(write);
+            if (diff == 0)
+            {
+                // slot is free, try to reserve it (write is reloaded on failure).
+                if (writeIndex.compare_exchange_weak(write, write + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0)
+            {
+                // the slot still holds a sample of the previous lap: full.
+                overflows.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else
+            {
+                // another producer took this slot in the meantime.
+                write = writeIndex.load(std::memory_order_relaxed);
+            }
+        }
+        buffer[write & mask] = item;
+        sequences[write & mask].store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+
+    // consumer side: hands the pending samples to f(const T *data, size_t count)
+    // as at most two contiguous blocks (the ring may wrap around), then frees
+    // them for the producers. Slots that are reserved but not yet written end
+    // the block, they are taken on the next call. Returns the number of
+    // consumed samples.
+    template <typename F>
+    size_t consume(F f, size_t maxCount = size_t(-1))
+    {
+        const size_t read = readIndex.load(std::memory_order_relaxed);
+        size_t count = 0;
+        while (count < maxCount && count < buffer.size() &&
+               sequences[(read + count) & mask].load(std::memory_order_acquire) == read + count + 1)
+            count++;
+        if (count == 0)
+            return 0;
+
+        const size_t first = read & mask;
+        const size_t firstCount = std::min(count, buffer.size() - first);
+        f(&buffer[first], firstCount);
+        if (count > firstCount)
+            f(&buffer[0], count - firstCount);
+
+        release(read, count);
+        return count;
+    }
+
+    // consumer side: drops all pending samples.
+    void clear()
+    {
+        consume([](const T *, size_t) {});
+    }
+
+private:
+    // hands count slots from read on back to the producers, for the next lap.
+    void release(size_t read, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            sequences[(read + i) & mask].store(read + i + buffer.size(), std::memory_order_release);
+        readIndex.store(read + count, std::memory_order_release);
+    }
+
+    std::vector<T> buffer;
+    std::unique_ptr<std::atomic<size_t>[]> sequences;
+    size_t mask;
+
+    // keep the indices on separate cache lines, otherwise producers and
+    // consumer keep invalidating each other.
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> readIndex{0};
+    alignas(64) std::atomic<uint64_t> overflows{0};
+};
+
+
+#endif // SAMPLERINGBUFFER_H
@@ -0,0 +1,379 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <QFile>
+#include <QString>
+
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "commons.h"
+#include "capnoview.h"
+
+
+// On-disk layout of a recorded session (little endian, as written by x86):
+//
+//   SessionFileHeader, padded to sessionFileHeaderSize
+//   chunk 0, chunk 1, ... each exactly chunkSize bytes:
+//     SessionChunkHeader, padded to sessionChunkHeaderSize
+//     records: SessionRecordHeader, count floats, uint32 CRC-32 of both
+//
+// All chunks have the same size, so chunk n starts at a known offset and its
+// header (time range, record count) works as the index for seeking. A chunk
+// header is only written once the chunk is full or the recorder is closed
+// ("sealed"), it carries the CRC-32 of the payload and of itself. After a
+// crash or power loss the last chunk has no valid header, its records are
+// then recovered one by one up to the first one with a bad CRC.
+const uint32_t sessionFileMagic = 0x43455243;  // "CREC"
+const uint32_t sessionChunkMagic = 0x4b4e4843; // "CHNK"
+const uint32_t sessionFormatVersion = 1;
+const size_t sessionFileHeaderSize = 64;
+const size_t sessionChunkHeaderSize = 64;
+
+struct SessionFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunkSize;
+    uint32_t reserved;
+    int64_t startTime;   // ms since epoch, when the recording started.
+};
+
+struct SessionChunkHeader
+{
+    uint32_t magic;
+    uint32_t index;          // position of the chunk in the file.
+    uint32_t payloadBytes;   // bytes of records after the header.
+    uint32_t recordCount;
+    double firstTime;        // time of the first and last record, sec.
+    double lastTime;
+    uint32_t payloadCrc;
+    uint32_t headerCrc;      // over all fields above.
+};
+
+struct SessionRecordHeader
+{
+    uint32_t count;          // number of float samples after the header.
+    uint8_t deviceType;
+    uint8_t connHandle;
+    uint8_t dataType;
+    uint8_t reserved;
+    uint64_t sequence;
+    double time;             // see CapnoSampleView.
+    double period;
+};
+
+
+// CRC-32 (IEEE 802.3), continue a running CRC by passing it as crc.
+inline uint32_t SessionCrc32(const void *data, size_t size, uint32_t crc = 0)
+{
+    static const std::array<uint32_t, 256> table = []()
+    {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+
+// Records everything that arrives in the user callback into a session file.
+//
+// The file is grown a chunk at a time and the current chunk is memory mapped,
+// so recording a packet is a memcpy into the page cache: no write call and no
+// fsync on the io thread. Sealed chunks are handed to a flusher thread that
+// syncs them (and the file header and size) to disk, close() syncs whatever
+// is left. So a sealed chunk is on disk shortly after it was sealed, the
+// records of the current chunk only once the OS wrote its pages back; after
+// a crash or power loss those are recovered as far as their CRCs allow (see
+// the layout above). Safe to call record() from several threads (library io
+// threads, simulator), the lock is only held for the copy.
+class SessionRecorder
+{
+public:
+    explicit SessionRecorder(size_t chunkSize = 1 << 20)
+        : chunkSize(chunkSize < 4096 ? 4096 : chunkSize)
+    {
+    }
+
+    ~SessionRecorder()
+    {
+        close();
+    }
+
+    // creates (or truncates) fileName. startTime is written to the file
+    // header, in ms since epoch.
+    bool open(const QString &fileName, int64_t startTime)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closeLocked();
+
+        file.setFileName(fileName);
+        if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+            return false;
+
+        char header[sessionFileHeaderSize] = {};
+        SessionFileHeader fileHeader = { sessionFileMagic, sessionFormatVersion, static_cast<uint32_t>(chunkSize), 0, startTime };
+        std::memcpy(header, &fileHeader, sizeof(fileHeader));
+        if (file.write(header, sizeof(header)) != sizeof(header) || !file.flush() || !beginChunk(0))
+        {
+            file.close();
+            return false;
+        }
+
+        // the flusher syncs the file header right away.
+        fileHandle = file.handle();
+        fileSyncPending = true;
+        stopFlushing = false;
+        flusher = std::thread(&SessionRecorder::flushLoop, this);
+        return true;
+    }
+
+    // seals the last chunk, syncs the file to disk and closes it.
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closeLocked();
+    }
+
+    bool isOpen() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return chunk != nullptr;
+    }
+
+    // packets that did not fit (larger than a chunk) or were lost to an I/O error.
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t recordCount() const { return records.load(std::memory_order_relaxed); }
+
+    void record(const CapnoSampleView &data, DeviceType device_type, uint8_t conn_handle, DataType data_type)
+    {
+        const size_t samplesBytes = data.size() * sizeof(float);
+        const size_t recordBytes = sizeof(SessionRecordHeader) + samplesBytes + sizeof(uint32_t);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!chunk)
+            return;
+        if (sessionChunkHeaderSize + recordBytes > chunkSize)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (chunkUsed + recordBytes > chunkSize)
+        {
+            const uint32_t next = chunkIndex + 1;
+            sealChunk();
+            if (!beginChunk(next))
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+
+        SessionRecordHeader header;
+        header.count = static_cast<uint32_t>(data.size());
+        header.deviceType = static_cast<uint8_t>(device_type);
+        header.connHandle = conn_handle;
+        header.dataType = static_cast<uint8_t>(data_type);
+        header.reserved = 0;
+        header.sequence = data.sequence;
+        header.time = data.time;
+        header.period = data.period;
+
+        uchar *out = chunk + chunkUsed;
+        std::memcpy(out, &header, sizeof(header));
+        std::memcpy(out + sizeof(header), data.begin(), samplesBytes);
+        const uint32_t crc = SessionCrc32(out, sizeof(header) + samplesBytes);
+        std::memcpy(out + sizeof(header) + samplesBytes, &crc, sizeof(crc));
+
+        // the payload CRC runs along, sealing a chunk does not read it again.
+        payloadCrc = SessionCrc32(out, recordBytes, payloadCrc);
+        if (chunkRecords == 0)
+            firstTime = data.time;
+        lastTime = data.time;
+        chunkRecords++;
+        chunkUsed += recordBytes;
+        records.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    // grows the file by one chunk and maps it (lock held).
+    bool beginChunk(uint32_t index)
+    {
+        const qint64 offset = sessionFileHeaderSize + qint64(index) * chunkSize;
+        // the new chunk reads as zeros until written, a reader stops there.
+        if (!file.resize(offset + chunkSize))
+            return false;
+        chunk = file.map(offset, chunkSize);
+        if (!chunk)
+            return false;
+        chunkIndex = index;
+        chunkUsed = sessionChunkHeaderSize;
+        chunkRecords = 0;
+        payloadCrc = 0;
+        firstTime = lastTime = 0;
+        return true;
+    }
+
+    // writes the chunk header and hands the chunk to the flusher (lock held).
+    // The chunks it is done with are unmapped here, QFile isn't thread-safe.
+    void sealChunk()
+    {
+        SessionChunkHeader header;
+        header.magic = sessionChunkMagic;
+        header.index = chunkIndex;
+        header.payloadBytes = static_cast<uint32_t>(chunkUsed - sessionChunkHeaderSize);
+        header.recordCount = chunkRecords;
+        header.firstTime = firstTime;
+        header.lastTime = lastTime;
+        header.payloadCrc = payloadCrc;
+        header.headerCrc = SessionCrc32(&header, offsetof(SessionChunkHeader, headerCrc));
+        std::memcpy(chunk, &header, sizeof(header));
+
+        std::lock_guard<std::mutex> flushLock(flushMutex);
+        for (uchar *flushed : flushedChunks)
+            file.unmap(flushed);
+        flushedChunks.clear();
+        flushQueue.push_back(chunk);
+        chunk = nullptr;
+        flushWake.notify_one();
+    }
+
+    void closeLocked()
+    {
+        if (chunk)
+        {
+            if (chunkRecords == 0)
+            {
+                // an empty last chunk is not kept.
+                file.unmap(chunk);
+                chunk = nullptr;
+                file.resize(sessionFileHeaderSize + qint64(chunkIndex) * chunkSize);
+            } else
+                sealChunk();
+        }
+        if (flusher.joinable())
+        {
+            // the flusher works off the chunks still queued before it stops,
+            // it never takes the recorder lock.
+            {
+                std::lock_guard<std::mutex> flushLock(flushMutex);
+                stopFlushing = true;
+            }
+            flushWake.notify_one();
+            flusher.join();
+            for (uchar *flushed : flushedChunks)
+                file.unmap(flushed);
+            flushedChunks.clear();
+            // takes the final size along.
+            syncFile(fileHandle);
+        }
+        if (file.isOpen())
+            file.close();
+    }
+
+    // flusher thread: syncs the sealed chunks, then the file itself (its
+    // size and header), off the io thread.
+    void flushLoop()
+    {
+        std::unique_lock<std::mutex> flushLock(flushMutex);
+        for (;;)
+        {
+            flushWake.wait(flushLock, [this]() { return !flushQueue.empty() || fileSyncPending || stopFlushing; });
+            if (flushQueue.empty() && !fileSyncPending)
+                return;
+
+            std::vector<uchar *> pending;
+            pending.swap(flushQueue);
+            fileSyncPending = false;
+            flushLock.unlock();
+
+            for (uchar *sealed : pending)
+                syncMapped(sealed, chunkSize);
+            syncFile(fileHandle);
+
+            flushLock.lock();
+            flushedChunks.insert(flushedChunks.end(), pending.begin(), pending.end());
+        }
+    }
+
+    // writes the mapped pages back and waits for them.
+    static void syncMapped(uchar *address, size_t size)
+    {
+#ifdef Q_OS_WIN
+        FlushViewOfFile(address, size);
+#else
+        // msync wants a page aligned address, QFile::map() returns one into
+        // the first page when the offset isn't aligned.
+        const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const uintptr_t start = reinterpret_cast<uintptr_t>(address) & ~(pageSize - 1);
+        msync(reinterpret_cast<void *>(start), size + (reinterpret_cast<uintptr_t>(address) - start), MS_SYNC);
+#endif
+    }
+
+    static void syncFile(int handle)
+    {
+#ifdef Q_OS_WIN
+        FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(handle)));
+#else
+        fsync(handle);
+#endif
+    }
+
+    const size_t chunkSize;
+
+    mutable std::mutex mutex;
+    QFile file;
+    uchar *chunk = nullptr;      // mapped current chunk.
+    uint32_t chunkIndex = 0;
+    size_t chunkUsed = 0;        // bytes used in the chunk, header included.
+    uint32_t chunkRecords = 0;
+    uint32_t payloadCrc = 0;
+    double firstTime = 0;
+    double lastTime = 0;
+
+    // flushing, guarded by flushMutex (taken after mutex, never before).
+    std::thread flusher;
+    std::mutex flushMutex;
+    std::condition_variable flushWake;
+    std::vector<uchar *> flushQueue;     // sealed chunks waiting for the flusher.
+    std::vector<uchar *> flushedChunks;  // synced chunks, still mapped.
+    bool fileSyncPending = false;
+    bool stopFlushing = false;
+    int fileHandle = -1;
+
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+
+#endif // SESSIONRECORDER_H
@@ -0,0 +1,308 @@
+#ifndef SESSIONREPLAY_H
+#define SESSIONREPLAY_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <QFile>
+#include <QString>
+
+#include "commons.h"
+#include "capnotrainer.h"
+#include "capnoview.h"
+#include "sessionrecorder.h"
+
+
+// Reads a session file written by SessionRecorder.
+//
+// Chunks are mapped one at a time. Sealed chunks are checked against their
+// payload CRC as a whole and skipped if it doesn't match, the unsealed last
+// chunk of a crashed recording is read up to the first record with a bad CRC.
+class SessionReader
+{
+public:
+    bool open(const QString &fileName)
+    {
+        close();
+        file.setFileName(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+
+        SessionFileHeader header;
+        if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header) ||
+            header.magic != sessionFileMagic || header.version != sessionFormatVersion ||
+            header.chunkSize <= sessionChunkHeaderSize)
+        {
+            file.close();
+            return false;
+        }
+        chunkSize = header.chunkSize;
+        startTime = header.startTime;
+        return true;
+    }
+
+    void close()
+    {
+        if (file.isOpen())
+            file.close();
+        corruptChunks = 0;
+    }
+
+    // ms since epoch, when the recording started.
+    int64_t sessionStartTime() const { return startTime; }
+    // chunks that were skipped or cut short because of a bad CRC.
+    int corruptChunkCount() const { return corruptChunks; }
+
+    // calls f(const SessionRecordHeader &header, const float *samples) for
+    // each record in file order. Stops early when f returns false, returns
+    // false then. samples points into the mapped file and is only valid
+    // during the call.
+    template <typename F>
+    bool forEachRecord(F f)
+    {
+        if (!file.isOpen())
+            return false;
+        corruptChunks = 0;
+
+        const qint64 chunkCount = (file.size() - qint64(sessionFileHeaderSize)) / chunkSize;
+        for (qint64 index = 0; index < chunkCount; index++)
+        {
+            uchar *chunk = file.map(sessionFileHeaderSize + index * chunkSize, chunkSize);
+            if (!chunk)
+                return false;
+            bool proceed = readChunk(chunk, static_cast<uint32_t>(index), f);
+            file.unmap(chunk);
+            if (!proceed)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    template <typename F>
+    bool readChunk(const uchar *chunk, uint32_t index, F &f)
+    {
+        SessionChunkHeader header;
+        std::memcpy(&header, chunk, sizeof(header));
+        const bool sealed = header.magic == sessionChunkMagic && header.index == index &&
+                header.headerCrc == SessionCrc32(&header, offsetof(SessionChunkHeader, headerCrc)) &&
+                header.payloadBytes <= chunkSize - sessionChunkHeaderSize;
+
+        const uchar *payload = chunk + sessionChunkHeaderSize;
+        size_t payloadBytes = chunkSize - sessionChunkHeaderSize;
+        if (sealed)
+        {
+            payloadBytes = header.payloadBytes;
+            if (SessionCrc32(payload, payloadBytes) != header.payloadCrc)
+            {
+                corruptChunks++;
+                return true;
+            }
+        }
+
+        size_t offset = 0;
+        while (offset + sizeof(SessionRecordHeader) + sizeof(uint32_t) <= payloadBytes)
+        {
+            SessionRecordHeader record;
+            std::memcpy(&record, payload + offset, sizeof(record));
+            const size_t samplesBytes = size_t(record.count) * sizeof(float);
+            if (samplesBytes > payloadBytes - offset - sizeof(record) - sizeof(uint32_t))
+                break;
+
+            if (!sealed)
+            {
+                // the payload CRC isn't there, check the record on its own.
+                uint32_t crc;
+                std::memcpy(&crc, payload + offset + sizeof(record) + samplesBytes, sizeof(crc));
+                if (crc != SessionCrc32(payload + offset, sizeof(record) + samplesBytes))
+                    break;
+            }
+
+            // records are 4 byte aligned, the samples can be used in place.
+            const float *samples = reinterpret_cast<const float *>(payload + offset + sizeof(record));
+            if (!f(record, samples))
+                return false;
+            offset += sizeof(record) + samplesBytes + sizeof(uint32_t);
+        }
+
+        // a crashed recording ends in an unsealed chunk, only count it if
+        // it was cut short by garbage rather than by zeros.
+        if (!sealed && offset + sizeof(SessionRecordHeader) <= payloadBytes)
+        {
+            for (size_t i = offset; i < offset + sizeof(SessionRecordHeader); i++)
+                if (payload[i] != 0)
+                {
+                    corruptChunks++;
+                    break;
+                }
+        }
+        return true;
+    }
+
+    QFile file;
+    size_t chunkSize = 0;
+    int64_t startTime = 0;
+    int corruptChunks = 0;
+};
+
+
+// Plays a recorded session back through the user callback.
+//
+// Like CapnoSimulator it calls the callback from a thread of its own, with
+// the original timing between the packets scaled by speed (1 real time, 100
+// a hundred times faster, 0 as fast as possible), so the app can be profiled
+// end to end without hardware.
+//
+// With a user_cb_t (the CapnoTrainer signature) the packets go through
+// MakeViewCallback again and get new timestamps and sequence numbers. With a
+// user_view_cb_t the recorded ones are handed out as they are, which keeps
+// the original time axis at any speed.
+class SessionReplay
+{
+public:
+    struct Statistics
+    {
+        uint64_t packets;
+        uint64_t samples;
+        // time spent inside the user callback.
+        double callbackSeconds;
+        double maxCallbackSeconds;
+    };
+
+    SessionReplay(user_cb_t callback, const QString &fileName, double speed = 1.0)
+        : callback(callback), fileName(fileName), speed(speed)
+    {
+    }
+
+    SessionReplay(user_view_cb_t viewCallback, const QString &fileName, double speed = 1.0)
+        : viewCallback(viewCallback), fileName(fileName), speed(speed)
+    {
+    }
+
+    ~SessionReplay()
+    {
+        stop();
+    }
+
+    // returns false if the file can't be read.
+    bool start()
+    {
+        if (running.load())
+            return true;
+        if (worker.joinable())
+            worker.join();
+        if (!reader.open(fileName))
+            return false;
+        running.store(true);
+        worker = std::thread(&SessionReplay::run, this);
+        return true;
+    }
+
+    void stop()
+    {
+        {
+            // under the lock, so the worker can't miss the wake up between
+            // checking running and starting to wait.
+            std::lock_guard<std::mutex> lock(waitMutex);
+            running.store(false);
+        }
+        wake.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // false once the whole session was played.
+    bool isRunning() const { return running.load(); }
+
+    // may be called from any thread while running.
+    Statistics statistics() const
+    {
+        Statistics s;
+        s.packets = packets.load(std::memory_order_relaxed);
+        s.samples = samples.load(std::memory_order_relaxed);
+        s.callbackSeconds = callbackNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        s.maxCallbackSeconds = maxCallbackNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        return s;
+    }
+
+private:
+    void run()
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        bool haveFirst = false;
+        double firstTime = 0;
+        std::vector<float> data;
+
+        reader.forEachRecord([&](const SessionRecordHeader &record, const float *recordSamples)
+        {
+            if (!running.load())
+                return false;
+
+            if (!haveFirst)
+            {
+                firstTime = record.time;
+                haveFirst = true;
+            }
+            if (speed > 0 && record.time > firstTime)
+            {
+                // gaps in a session can be long, stop() must not wait them out.
+                const auto due = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>((record.time - firstTime) / speed));
+                std::unique_lock<std::mutex> lock(waitMutex);
+                if (wake.wait_until(lock, due, [this]() { return !running.load(); }))
+                    return false;
+            }
+
+            const DeviceType deviceType = static_cast<DeviceType>(record.deviceType);
+            const DataType dataType = static_cast<DataType>(record.dataType);
+            const auto before = std::chrono::steady_clock::now();
+            if (viewCallback)
+            {
+                CapnoSampleView view = { recordSamples, record.count, record.sequence, record.time, record.period };
+                viewCallback(view, deviceType, record.connHandle, dataType);
+            } else
+            {
+                data.assign(recordSamples, recordSamples + record.count);
+                callback(data, deviceType, record.connHandle, dataType);
+            }
+            const uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - before).count();
+
+            packets.fetch_add(1, std::memory_order_relaxed);
+            samples.fetch_add(record.count, std::memory_order_relaxed);
+            callbackNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+            // only the replay thread writes it.
+            if (nanoseconds > maxCallbackNanoseconds.load(std::memory_order_relaxed))
+                maxCallbackNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+            return true;
+        });
+        reader.close();
+        running.store(false);
+    }
+
+    user_cb_t callback;
+    user_view_cb_t viewCallback;
+    QString fileName;
+    double speed;
+
+    SessionReader reader;
+    std::atomic<bool> running{false};
+    std::thread worker;
+    std::mutex waitMutex;
+    std::condition_variable wake;    // stop() interrupts the wait for the next record.
+
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> callbackNanoseconds{0};
+    std::atomic<uint64_t> maxCallbackNanoseconds{0};
+};
+
+
+#endif // SESSIONREPLAY_H
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Benchmarks of the data hot paths of QCustomPlot
+# (adaptive sampling, color map colorizing).
+# Run with
+#   qmake && make && ./tst_benchmark
+# (QT_QPA_PLATFORM=offscreen without a display).
+# Build with QMAKE_CXXFLAGS += -mavx2 (or /arch:AVX2)
+# to measure the AVX2 kernels instead of SSE2.
+#
+#-------------------------------------------------
+
+QT       += core gui testlib printsupport
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = tst_benchmark
+TEMPLATE = app
+CONFIG += console release
+
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += tst_benchmark.cpp \
+        ../../qcustomplot.cpp
+
+HEADERS  += ../../qcustomplot.h
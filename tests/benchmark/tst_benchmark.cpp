@@ -0,0 +1,106 @@
+#include <QtTest/QtTest>
+#include <qmath.h>
+
+#include "qcustomplot.h"
+
+
+// Times the data paths of a replot that don't depend on the paint device:
+// the adaptive sampling of long graphs and the colorizing of color maps. The
+// plot is laid out once by a replot, then only the measured function runs in
+// the QBENCHMARK loop.
+class TestBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void adaptiveSampling_data();
+    void adaptiveSampling();
+    void colorize_data();
+    void colorize();
+};
+
+namespace {
+// makes the protected line generation of QCPGraph callable.
+class SamplingGraph : public QCPGraph
+{
+public:
+    SamplingGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) : QCPGraph(keyAxis, valueAxis) {}
+    using QCPGraph::getLines;
+};
+}
+
+
+void TestBenchmark::adaptiveSampling_data()
+{
+    QTest::addColumn<int>("points");
+    QTest::addColumn<bool>("pyramid");
+    QTest::newRow("1M points") << 1000000 << false;
+    QTest::newRow("1M points, min/max pyramid") << 1000000 << true;
+    QTest::newRow("10M points") << 10000000 << false;
+    QTest::newRow("10M points, min/max pyramid") << 10000000 << true;
+}
+
+// a noisy sine over a 1500 px wide axis rect, all of it visible.
+void TestBenchmark::adaptiveSampling()
+{
+    QFETCH(int, points);
+    QFETCH(bool, pyramid);
+
+    QCustomPlot plot;
+    plot.resize(1600, 400);
+    SamplingGraph *graph = new SamplingGraph(plot.xAxis, plot.yAxis);
+    QVector<double> keys(points), values(points);
+    for (int i = 0; i < points; i++)
+    {
+        keys[i] = i * 0.01;
+        values[i] = 20 + 20 * qSin(i * 0.001) + (qint64(i) * 7919 % 100) * 0.01;
+    }
+    graph->setData(keys, values, true);
+    graph->data()->setMinMaxPyramid(pyramid);
+    plot.xAxis->setRange(0, keys.last());
+    plot.yAxis->setRange(0, 45);
+    plot.replot();
+
+    QVector<QPointF> lines;
+    QBENCHMARK
+    {
+        graph->getLines(&lines, QCPDataRange(0, graph->dataCount()));
+    }
+    QVERIFY(!lines.isEmpty());
+}
+
+void TestBenchmark::colorize_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("logarithmic");
+    for (int size = 256; size <= 4096; size *= 4)
+    {
+        QTest::newRow(qPrintable(QString("%1^2 linear").arg(size))) << size << false;
+        QTest::newRow(qPrintable(QString("%1^2 logarithmic").arg(size))) << size << true;
+    }
+}
+
+// one full color map image, row by row like QCPColorMap::updateMapImage.
+void TestBenchmark::colorize()
+{
+    QFETCH(int, size);
+    QFETCH(bool, logarithmic);
+
+    QVector<double> data(size * size);
+    for (int i = 0; i < data.size(); i++)
+        data[i] = 1 + 99 * (qint64(i) * 7919 % 100000) / 100000.0;
+    QCPColorGradient gradient(QCPColorGradient::gpJet);
+    const QCPRange range(1, 100);
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+
+    QBENCHMARK
+    {
+        for (int y = 0; y < size; y++)
+            gradient.colorize(data.constData() + y * size, range, reinterpret_cast<QRgb*>(image.scanLine(y)), size, 1, logarithmic);
+    }
+}
+
+
+QTEST_MAIN(TestBenchmark)
+
+#include "tst_benchmark.moc"
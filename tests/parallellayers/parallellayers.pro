@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Checks that QCP::phParallelLayers draws the same
+# pixels as the serial replot. Run with
+#   qmake && make && make check
+# (QT_QPA_PLATFORM=offscreen without a display)
+#
+#-------------------------------------------------
+
+QT       += core gui testlib printsupport
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = tst_parallellayers
+TEMPLATE = app
+CONFIG += testcase console
+
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += tst_parallellayers.cpp \
+        ../../qcustomplot.cpp
+
+HEADERS  += ../../qcustomplot.h
@@ -0,0 +1,271 @@
+#include <QtTest/QtTest>
+#include <qmath.h>
+
+#include "qcustomplot.h"
+
+
+// Renders the same plot with and without QCP::phParallelLayers and compares
+// the pixels. The layers are drawn into QImage paint buffers on the plot's
+// thread pool in the parallel case, so any state shared between layerables
+// of different layers, or any difference between the paint buffer types,
+// shows up as a pixel mismatch.
+class TestParallelLayers : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void samePixels_data();
+    void samePixels();
+    void repeatedReplots();
+    void globalPoolBusy();
+    void sharedPyramidContainer();
+    void scrollingLayers();
+
+private:
+    static void setupPlot(QCustomPlot *plot, bool parallel, int layerCount);
+    static void setupStripChart(QCustomPlot *plot, bool parallel, bool scroll);
+    static void appendStripData(QCustomPlot *plot, int first, int count);
+    static QImage render(QCustomPlot *plot);
+};
+
+
+// one buffered layer per signal, like the CO2 graphs of the app, plus a
+// colormap and bars on layers of their own and the default logical layers.
+void TestParallelLayers::setupPlot(QCustomPlot *plot, bool parallel, int layerCount)
+{
+    plot->setPlottingHint(QCP::phParallelLayers, parallel);
+    plot->resize(800, 600);
+
+    for (int l = 0; l < layerCount; l++)
+    {
+        const QString name = QString("signal%1").arg(l);
+        plot->addLayer(name, plot->layer("main"), QCustomPlot::limAbove);
+        plot->layer(name)->setMode(QCPLayer::lmBuffered);
+
+        QCPGraph *graph = plot->addGraph();
+        graph->setLayer(name);
+        graph->setPen(QPen(QColor::fromHsv((l * 47) % 360, 255, 200), 1 + l % 3));
+        if (l % 2)
+            graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCircle, 4));
+        QVector<double> keys(2000), values(2000);
+        for (int i = 0; i < keys.size(); i++)
+        {
+            keys[i] = i / 100.0;
+            values[i] = 20 + 15 * qSin(keys[i] * (1 + l) * 0.7) + l;
+        }
+        graph->setData(keys, values, true);
+    }
+
+    plot->addLayer("map", plot->layer("main"), QCustomPlot::limAbove);
+    plot->layer("map")->setMode(QCPLayer::lmBuffered);
+    QCPColorMap *map = new QCPColorMap(plot->xAxis, plot->yAxis);
+    map->setLayer("map");
+    map->data()->setSize(300, 300);
+    map->data()->setRange(QCPRange(0, 5), QCPRange(0, 10));
+    for (int x = 0; x < 300; x++)
+        for (int y = 0; y < 300; y++)
+            map->data()->setCell(x, y, qSin(x * 0.05) * qCos(y * 0.07));
+    map->setGradient(QCPColorGradient::gpPolar);
+    map->rescaleDataRange();
+
+    plot->addLayer("bars", plot->layer("main"), QCustomPlot::limAbove);
+    plot->layer("bars")->setMode(QCPLayer::lmBuffered);
+    QCPBars *bars = new QCPBars(plot->xAxis, plot->yAxis);
+    bars->setLayer("bars");
+    bars->setWidth(0.3);
+    for (int i = 0; i < 20; i++)
+        bars->addData(i, 5 + i % 7);
+
+    plot->xAxis->setRange(0, 20);
+    plot->yAxis->setRange(0, 50);
+}
+
+// two graphs on buffered layers of their own, like the CO2 plot of the app,
+// and the static axes on a cached layer. With scroll set, the graph layers
+// shift their buffers along the time axis, otherwise they are redrawn
+// completely on every replot.
+void TestParallelLayers::setupStripChart(QCustomPlot *plot, bool parallel, bool scroll)
+{
+    plot->setPlottingHint(QCP::phParallelLayers, parallel);
+    // the rasterization of antialiased lines at the edge of a redrawn strip
+    // isn't what is tested here, the handling of the kept buffers is.
+    plot->setNotAntialiasedElements(QCP::aeAll);
+    plot->resize(800, 600);
+
+    for (int l = 0; l < 2; l++)
+    {
+        const QString name = QString("signal%1").arg(l);
+        plot->addLayer(name, plot->layer("main"), QCustomPlot::limAbove);
+        plot->layer(name)->setMode(QCPLayer::lmBuffered);
+        if (scroll)
+            plot->layer(name)->setScrollAxis(plot->xAxis);
+        QCPGraph *graph = plot->addGraph();
+        graph->setLayer(name);
+        graph->setPen(QPen(l ? Qt::red : Qt::blue, 1 + l));
+    }
+    if (scroll)
+    {
+        plot->layer("axes")->setMode(QCPLayer::lmBuffered);
+        plot->layer("axes")->setAxisCache(true);
+        plot->xAxis->setLayer("legend");
+    }
+    plot->yAxis->setRange(0, 50);
+}
+
+// count samples at 100 Hz, starting with sample first.
+void TestParallelLayers::appendStripData(QCustomPlot *plot, int first, int count)
+{
+    for (int l = 0; l < 2; l++)
+        for (int i = first; i < first + count; i++)
+            plot->graph(l)->addData(i / 100.0, 20 + 15 * qSin(i * 0.013 * (1 + l)) + l);
+}
+
+QImage TestParallelLayers::render(QCustomPlot *plot)
+{
+    // grab() paints the widget from its paint buffers, which is the path
+    // phParallelLayers changes (toImage would draw the layers directly).
+    plot->replot();
+    return plot->grab().toImage().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+
+void TestParallelLayers::samePixels_data()
+{
+    QTest::addColumn<int>("layerCount");
+    QTest::newRow("one layer") << 1;
+    QTest::newRow("fewer layers than threads") << 3;
+    QTest::newRow("more layers than threads") << 4 * QThread::idealThreadCount() + 1;
+}
+
+void TestParallelLayers::samePixels()
+{
+    QFETCH(int, layerCount);
+
+    QCustomPlot serial, parallel;
+    setupPlot(&serial, false, layerCount);
+    setupPlot(&parallel, true, layerCount);
+
+    const QImage expected = render(&serial);
+    const QImage actual = render(&parallel);
+    QCOMPARE(actual.size(), expected.size());
+    QVERIFY(actual == expected);
+}
+
+// the layers must come out the same on every replot, not only on the first.
+void TestParallelLayers::repeatedReplots()
+{
+    QCustomPlot serial, parallel;
+    setupPlot(&serial, false, 8);
+    setupPlot(&parallel, true, 8);
+
+    for (int i = 0; i < 20; i++)
+    {
+        serial.xAxis->moveRange(0.25);
+        parallel.xAxis->moveRange(0.25);
+        QVERIFY(render(&parallel) == render(&serial));
+    }
+}
+
+namespace {
+// occupies a thread of the global pool until released.
+class BlockingTask : public QRunnable
+{
+public:
+    explicit BlockingTask(QSemaphore *release) : release(release) {}
+    void run() override { release->acquire(); }
+private:
+    QSemaphore *release;
+};
+}
+
+// the layers are drawn on the plot's own pool, so an application that keeps
+// every thread of the global pool busy must not stall the replot.
+void TestParallelLayers::globalPoolBusy()
+{
+    QThreadPool *globalPool = QThreadPool::globalInstance();
+    QSemaphore release;
+    const int blockers = globalPool->maxThreadCount();
+    for (int i = 0; i < blockers; i++)
+        globalPool->start(new BlockingTask(&release));
+
+    QCustomPlot serial, parallel;
+    setupPlot(&serial, false, 4);
+    setupPlot(&parallel, true, 4);
+    const bool same = render(&parallel) == render(&serial);
+
+    release.release(blockers);
+    globalPool->waitForDone();
+    QVERIFY(same);
+}
+
+// graphs on different layers share one data container with the min/max
+// pyramid, so the parallel layers query it at the same time. Appending
+// between the replots updates the pyramid, which must happen on the GUI
+// thread only.
+void TestParallelLayers::sharedPyramidContainer()
+{
+    QSharedPointer<QCPGraphDataContainer> data(new QCPGraphDataContainer);
+    data->setMinMaxPyramid(true);
+    for (int i = 0; i < 1000000; i++)
+        data->add(QCPGraphData(i * 0.001, 20 + 15 * qSin(i * 0.0007) + (i % 13) * 0.1));
+
+    QCustomPlot serial, parallel;
+    setupPlot(&serial, false, 4);
+    setupPlot(&parallel, true, 4);
+    foreach (QCustomPlot *plot, QList<QCustomPlot*>() << &serial << &parallel)
+    {
+        for (int g = 0; g < plot->graphCount(); g++)
+        {
+            plot->graph(g)->setData(data);
+            plot->graph(g)->setAdaptiveSampling(true);
+        }
+        plot->xAxis->setRange(0, 1000);
+    }
+
+    for (int i = 0; i < 10; i++)
+    {
+        QVERIFY(render(&parallel) == render(&serial));
+        const double next = (data->constEnd()-1)->key;
+        for (int j = 1; j <= 20000; j++)
+            data->add(QCPGraphData(next + j * 0.001, 20 + 15 * qSin(j * 0.003)));
+        serial.xAxis->moveRange(20);
+        parallel.xAxis->moveRange(20);
+    }
+}
+
+// layers that shift their buffers (scroll axis) and keep them (axis cache),
+// drawn in parallel, must give the same pixels as serial full redraws.
+void TestParallelLayers::scrollingLayers()
+{
+    QCustomPlot serial, parallel;
+    setupStripChart(&serial, false, false);
+    setupStripChart(&parallel, true, true);
+    appendStripData(&serial, 0, 1000);
+    appendStripData(&parallel, 0, 1000);
+
+    // one sample per pixel, so a step of five samples scrolls five pixels.
+    render(&serial);
+    const double width = serial.xAxis->axisRect()->width() / 100.0;
+    serial.xAxis->setRange(10 - width, 10);
+    parallel.xAxis->setRange(10 - width, 10);
+    QVERIFY(render(&parallel) == render(&serial));
+
+    for (int step = 0; step < 50; step++)
+    {
+        appendStripData(&serial, 1000 + step * 5, 5);
+        appendStripData(&parallel, 1000 + step * 5, 5);
+        serial.xAxis->moveRange(0.05);
+        parallel.xAxis->moveRange(0.05);
+        if (step == 25) // the cached axes must be redrawn when their range changes
+        {
+            serial.yAxis->setRange(0, 45);
+            parallel.yAxis->setRange(0, 45);
+        }
+        QVERIFY(render(&parallel) == render(&serial));
+    }
+}
+
+
+QTEST_MAIN(TestParallelLayers)
+
+#include "tst_parallellayers.moc"
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Checks that ReportRenderer writes the same images
+# as rendering every report on its own, also when
+# called from a worker thread. Run with
+#   qmake && make && make check
+# (QT_QPA_PLATFORM=offscreen without a display)
+#
+#-------------------------------------------------
+
+QT       += core gui testlib printsupport
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = tst_reportrenderer
+TEMPLATE = app
+CONFIG += testcase console
+
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += tst_reportrenderer.cpp \
+        ../../qcustomplot.cpp
+
+HEADERS  += ../../qcustomplot.h \
+        ../../timeaxisticker.h \
+        ../../reportrenderer.h
@@ -0,0 +1,93 @@
+#include <QtTest/QtTest>
+#include <qmath.h>
+
+#include <thread>
+
+#include "reportrenderer.h"
+
+
+// The renderer keeps one plot for all reports and only swaps the data, so a
+// report must come out the same as when it is rendered by a fresh renderer,
+// whatever was rendered before it.
+class TestReportRenderer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sameAsSingleReports();
+    void fromWorkerThread();
+
+private:
+    static std::vector<CapnoReport> makeReports(const QString &dir, int count);
+    static QImage load(const QString &fileName);
+};
+
+
+// sessions of different lengths and breathing rates, so the time axis range
+// and tick labels change from one report to the next.
+std::vector<CapnoReport> TestReportRenderer::makeReports(const QString &dir, int count)
+{
+    std::vector<CapnoReport> reports;
+    for (int r = 0; r < count; r++)
+    {
+        CapnoReport report;
+        report.fileName = QString("%1/report%2.png").arg(dir).arg(r);
+        const int samples = 2000 + 1500 * r;
+        for (int i = 0; i < samples; i++)
+        {
+            report.time.append(i / 20.0);
+            report.co2.append(19 + 19 * qSin(i / 20.0 * 2 * M_PI / (3 + r)));
+        }
+        reports.push_back(report);
+    }
+    return reports;
+}
+
+QImage TestReportRenderer::load(const QString &fileName)
+{
+    return QImage(fileName).convertToFormat(QImage::Format_ARGB32);
+}
+
+
+void TestReportRenderer::sameAsSingleReports()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const std::vector<CapnoReport> reports = makeReports(dir.path(), 8);
+
+    ReportRenderer batch(800, 400);
+    QCOMPARE(batch.render(reports), int(reports.size()));
+
+    for (const CapnoReport &report : reports)
+    {
+        ReportRenderer single(800, 400);
+        const QImage expected = single.plotReport(report).convertToFormat(QImage::Format_ARGB32);
+        const QImage actual = load(report.fileName);
+        QCOMPARE(actual.size(), QSize(800, 400));
+        QVERIFY(actual == expected);
+    }
+}
+
+// a batch export driven by a worker thread, while the GUI thread keeps
+// processing events (it plots the reports).
+void TestReportRenderer::fromWorkerThread()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const std::vector<CapnoReport> reports = makeReports(dir.path(), 6);
+
+    ReportRenderer renderer(640, 320, 2.0);
+    std::atomic<int> saved{-1};
+    std::thread worker([&]() { saved.store(renderer.render(reports)); });
+    QTRY_VERIFY_WITH_TIMEOUT(saved.load() >= 0, 60000);
+    worker.join();
+
+    QCOMPARE(saved.load(), int(reports.size()));
+    for (const CapnoReport &report : reports)
+        QCOMPARE(load(report.fileName).size(), QSize(1280, 640));
+}
+
+
+QTEST_MAIN(TestReportRenderer)
+
+#include "tst_reportrenderer.moc"
@@ -8,6 +8,9 @@
 #include "capnotrainer_hrv.h"
 #include "capnotrainer_emg.h"
 
+// the read/write sizes are compiled into libcapnotrainergo, they size the
+// read buffers inside CapnoTrainer. Changing them here without rebuilding the
+// library changes the class layout the library was built against.
 #define CAPNOTRAINER_SERIAL_READ_SIZE 64
 #define CAPNOTRAINER_SERIAL_WRITE_SIZE 16
 
@@ -0,0 +1,29 @@
+#ifndef TIMEAXISTICKER_H
+#define TIMEAXISTICKER_H
+
+#include <QString>
+#include <QLocale>
+
+#include "qcustomplot.h"
+
+
+// labels the x-axis seconds as mm:ss, negative times stay unlabeled.
+class TimeAxisTicker : public QCPAxisTicker
+{
+public:
+    QString getTickLabel(double tick, const QLocale &locale, QChar formatChar, int precision) override
+    {
+        Q_UNUSED(locale)
+        Q_UNUSED(formatChar)
+        Q_UNUSED(precision)
+
+        int totalSeconds = static_cast<int>(tick);
+        int minutes = totalSeconds / 60;
+        int seconds = totalSeconds % 60;
+
+        return tick >= 0 ? QString("%1:%2").arg(minutes, 2, 10, QChar('0')).arg(seconds, 2, 10, QChar('0')) : QString("");
+    }
+};
+
+
+#endif // TIMEAXISTICKER_H